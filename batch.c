@@ -0,0 +1,401 @@
+#include "batch.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "dd.h"
+#include "floatexp.h"
+#include "shader.h"
+#include "palette.h"
+#include "iterfield.h"
+#include "fieldvideo.h"
+#include "perturb.h"
+#include "util.h"
+
+#define MAX_LINE_SIZE (4 * MAX_PATH_SIZE)
+#define WORK_GROUP_SIZE 32
+#define SLICE_GROUPS 8
+#define PROGRESS_FRAMES 20
+
+typedef struct {
+    char zoom;
+    unsigned int width;
+    unsigned int height;
+    char settings[MAX_PATH_SIZE];
+    char palette[MAX_PATH_SIZE];
+    char output[MAX_PATH_SIZE];
+} batch_job;
+
+// the part of a settings file a job uses. defaults are the ones main starts with
+typedef struct {
+    dd x_offset, y_offset;
+    fe mag;
+    unsigned int max_iters;
+    unsigned int antialiasing;
+    dd julia_cx, julia_cy;
+    fe rec_mag;
+    double rec_vel;
+    unsigned int rec_fps;
+    unsigned int rec_bitrate;
+} job_settings;
+
+// identifies the frames of a zoom: everything that changes what gets computed, but not the palette or bitrate
+static unsigned long long zoom_key(const job_settings *s, const char *defines) {
+    unsigned long long h = FNV_OFFSET;
+    h = hash_bytes(h, &s->x_offset, sizeof(s->x_offset));
+    h = hash_bytes(h, &s->y_offset, sizeof(s->y_offset));
+    h = hash_bytes(h, &s->mag.m, sizeof(s->mag.m));
+    h = hash_bytes(h, &s->mag.e, sizeof(s->mag.e));
+    h = hash_bytes(h, &s->max_iters, sizeof(s->max_iters));
+    h = hash_bytes(h, &s->antialiasing, sizeof(s->antialiasing));
+    h = hash_bytes(h, &s->julia_cx, sizeof(s->julia_cx));
+    h = hash_bytes(h, &s->julia_cy, sizeof(s->julia_cy));
+    h = hash_bytes(h, &s->rec_mag.m, sizeof(s->rec_mag.m));
+    h = hash_bytes(h, &s->rec_mag.e, sizeof(s->rec_mag.e));
+    h = hash_bytes(h, &s->rec_vel, sizeof(s->rec_vel));
+    return hash_bytes(h, defines, strlen(defines));
+}
+
+// reads the commands the save command writes. anything only the interactive session uses is ignored
+static char load_settings(const char *filename, job_settings *s) {
+    FILE *file = fopen(filename, "r");
+    if (!file)
+        return 0;
+
+    char line[MAX_LINE_SIZE];
+    while (fgets(line, sizeof(line), file)) {
+        char name[64], arg[256];
+        if (sscanf(line, "%63s %255s", name, arg) != 2)
+            continue;
+        if (!strcmp(name, "set_pos"))
+            sscanf(arg, "{%16llx%16llx,%16llx%16llx}", (unsigned long long*)&s->x_offset.x, (unsigned long long*)&s->x_offset.y, (unsigned long long*)&s->y_offset.x, (unsigned long long*)&s->y_offset.y);
+        else if (!strcmp(name, "set_mag") || !strcmp(name, "rec_set_mag"))
+            fe_scan_hex(arg, name[0] == 'r' ? &s->rec_mag : &s->mag);
+        else if (!strcmp(name, "set_iters") && sscanf(arg, "%u", &s->max_iters) == 1 && !s->max_iters)
+            s->max_iters = 1;
+        else if (!strcmp(name, "set_aa"))
+            sscanf(arg, "%u", &s->antialiasing);
+        else if (!strcmp(name, "set_julia"))
+            sscanf(arg, "{%16llx%16llx,%16llx%16llx}", (unsigned long long*)&s->julia_cx.x, (unsigned long long*)&s->julia_cx.y, (unsigned long long*)&s->julia_cy.x, (unsigned long long*)&s->julia_cy.y);
+        else if (!strcmp(name, "rec_set_vel"))
+            sscanf(arg, "%lf", &s->rec_vel);
+        else if (!strcmp(name, "rec_set_fps"))
+            sscanf(arg, "%u", &s->rec_fps);
+        else if (!strcmp(name, "rec_set_bitrate"))
+            sscanf(arg, "%u", &s->rec_bitrate);
+    }
+    fclose(file);
+    return 1;
+}
+
+static unsigned int load_jobs(FILE *file, const char *filename, batch_job **jobs) {
+    char line[MAX_LINE_SIZE];
+    unsigned int count = 0, capacity = 0, line_number = 0;
+    *jobs = NULL;
+    while (fgets(line, sizeof(line), file)) {
+        ++line_number;
+        char kind[16];
+        if (sscanf(line, "%15s", kind) != 1 || kind[0] == '#')
+            continue;
+
+        batch_job job;
+        if (sscanf(line, "%15s %ux%u %1023s %1023s %1023s", kind, &job.width, &job.height, job.settings, job.palette, job.output) != 6 ||
+                (strcmp(kind, "still") && strcmp(kind, "zoom")) ||
+                !job.width || !job.height || job.width % WORK_GROUP_SIZE || job.height % WORK_GROUP_SIZE) {
+            fprintf(stderr, "%s:%u: invalid job. expected 'still|zoom <w>x<h> <settings> <palette> <output>' with w and h multiples of %u.\n", filename, line_number, WORK_GROUP_SIZE);
+            exit(EXIT_FAILURE);
+        }
+        job.zoom = !strcmp(kind, "zoom");
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            *jobs = realloc(*jobs, capacity * sizeof(batch_job));
+        }
+        (*jobs)[count++] = job;
+    }
+    return count;
+}
+
+// output.ext -> output.partial.ext, so the container is still picked by the extension
+static void partial_filename(const char *filename, char *partial) {
+    const char *ext = strrchr(filename, '.');
+    const char *slash = strrchr(filename, '/');
+    if (!ext || (slash && ext < slash))
+        ext = filename + strlen(filename);
+    sprintf(partial, "%.*s.partial%s", (int)(ext - filename), filename, ext);
+}
+
+// outputs only appear under their final name once complete, that's what tells a rerun to skip them
+static char write_still(const char *filename, unsigned int w, unsigned int h, const unsigned int *iters, unsigned int max_iters, const unsigned char hue_rgb[256][3]) {
+    char partial[MAX_PATH_SIZE + 16];
+    partial_filename(filename, partial);
+    FILE *file = fopen(partial, "wb");
+    if (!file)
+        return 0;
+
+    unsigned char *image = malloc(w * h * 3);
+    color_iters(iters, w * h, max_iters, max_iters, hue_rgb, image);
+    fprintf(file, "P6\n%u %u\n255\n", w, h);
+    // rows come bottom to top from gl
+    for (unsigned int y = h; y-- > 0;)
+        fwrite(image + y * w * 3, w * 3, 1, file);
+    char ok = !ferror(file);
+    fclose(file);
+    free(image);
+    return ok && !rename(partial, filename);
+}
+
+// computes one view and reads back its escape counts. the slices keep each dispatch short so
+// jobs sharing the gpu with each other (and the desktop) don't trip the driver watchdog
+static void compute_view(unsigned int prog, unsigned int w, unsigned int h, const job_settings *s, fe mag, unsigned int power, unsigned int iter_texture, unsigned int *iters) {
+    glUseProgram(prog);
+    glUniform1d(glGetUniformLocation(prog, "mag_m"), mag.m);
+    glUniform1i(glGetUniformLocation(prog, "mag_exp"), mag.e);
+    glUniform1ui(glGetUniformLocation(prog, "perturb"), use_perturbation(power, mag, w));
+    glUniform2d(glGetUniformLocation(prog, "offsetx"), s->x_offset.x, s->x_offset.y);
+    glUniform2d(glGetUniformLocation(prog, "offsety"), s->y_offset.x, s->y_offset.y);
+    glUniform2d(glGetUniformLocation(prog, "julia_cx"), s->julia_cx.x, s->julia_cx.y);
+    glUniform2d(glGetUniformLocation(prog, "julia_cy"), s->julia_cy.x, s->julia_cy.y);
+    glUniform1ui(glGetUniformLocation(prog, "antialiasing"), s->antialiasing);
+    glUniform1ui(glGetUniformLocation(prog, "max_iters"), s->max_iters);
+    glUniform1ui(glGetUniformLocation(prog, "palette_iters"), s->max_iters);
+
+    for (unsigned int row = 0; row < h; row += SLICE_GROUPS * WORK_GROUP_SIZE) {
+        unsigned int groups = (h - row) / WORK_GROUP_SIZE < SLICE_GROUPS ? (h - row) / WORK_GROUP_SIZE : SLICE_GROUPS;
+        glUniform1ui(glGetUniformLocation(prog, "row_offset"), row);
+        glDispatchCompute(w / WORK_GROUP_SIZE, groups, 1);
+        glFlush();
+    }
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glGetTextureImage(iter_texture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, w * h * sizeof(unsigned int), iters);
+}
+
+// runs in the job's own process, so failing just ends the job
+static char render_job(const batch_job *job, unsigned int index, char julia, unsigned int power, const char *defines) {
+    job_settings s = { {0.0, 0.0}, {0.0, 0.0}, {0.5, 0}, 1300, 0, {-0.8, 0.0}, {0.156, 0.0}, {0.5, 0}, 0.0, 30, 100000 };
+    if (!load_settings(job->settings, &s)) {
+        fprintf(stderr, "job %u: unable to load settings at '%s'.\n", index, job->settings);
+        return 0;
+    }
+    if (job->zoom && (s.rec_vel <= 1.0 || !s.rec_fps || !fe_gt(s.rec_mag, s.mag))) {
+        fprintf(stderr, "job %u: a zoom needs rec_set_vel above 1 and rec_set_mag past set_mag.\n", index);
+        return 0;
+    }
+
+    color start_color;
+    unsigned int interval_count;
+    interval intervals[MAX_INTERVAL_COUNT];
+    if (!load_palette(job->palette, &start_color, &interval_count, intervals)) {
+        fprintf(stderr, "job %u: unable to load palette at '%s'.\n", index, job->palette);
+        return 0;
+    }
+    unsigned char hue_rgb[256][3];
+    gen_hue_rgb(start_color, interval_count, intervals, hue_rgb);
+
+    if (!glfwInit()) {
+        const char *description;
+        int code = glfwGetError(&description);
+        fprintf(stderr, "job %u: glfw failed to initialize.\nerror (%d): %s\n", index, code, description);
+        return 0;
+    }
+    // nothing is drawn, the window only provides the context
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(1, 1, "batch", NULL, NULL);
+    if (!window) {
+        fprintf(stderr, "job %u: unable to create a gl context.\n", index);
+        glfwTerminate();
+        return 0;
+    }
+    glfwMakeContextCurrent(window);
+
+    GLenum err;
+    if ((err = glewInit()) != GLEW_OK) {
+        fprintf(stderr, "job %u: glew failed to initialize.\nerror (%u): %s\n", index, err, glewGetErrorString(err));
+        glfwTerminate();
+        return 0;
+    }
+
+    const unsigned int w = job->width, h = job->height;
+
+    // genset.glsl writes all three images, only the escape counts are read back
+    unsigned int textures[3];
+    const GLenum formats[3] = { GL_R8UI, GL_R32UI, GL_R32UI };
+    const unsigned int bindings[3] = { 0, 2, 3 };
+    glGenTextures(3, textures);
+    for (unsigned int i = 0; i < 3; ++i) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, formats[i], w, h, 0, GL_RED_INTEGER, formats[i] == GL_R8UI ? GL_UNSIGNED_BYTE : GL_UNSIGNED_INT, NULL);
+        glBindImageTexture(bindings[i], textures[i], 0, GL_FALSE, 0, GL_WRITE_ONLY, formats[i]);
+    }
+
+    unsigned int stats_buffer;
+    glGenBuffers(1, &stats_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stats_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (w / WORK_GROUP_SIZE) * (h / WORK_GROUP_SIZE) * TILE_STATS_SIZE * sizeof(unsigned int), NULL, GL_DYNAMIC_READ);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, stats_buffer);
+
+    // the center and limit are fixed for the whole job, so one reference orbit serves every frame
+    unsigned int orbit_buffer;
+    glGenBuffers(1, &orbit_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, orbit_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, orbit_buffer);
+    unsigned int orbit_len = 0;
+    if (power == 2) {
+        double *orbit = malloc((s.max_iters + 1) * 2 * sizeof(double));
+        orbit_len = gen_ref_orbit(julia, s.x_offset, s.y_offset, s.julia_cx, s.julia_cy, s.max_iters, orbit);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, orbit_len * 2 * sizeof(double), orbit, GL_STATIC_DRAW);
+        free(orbit);
+    }
+
+    unsigned int prog = compile_compute_shader(genset_src, defines);
+    glUseProgram(prog);
+    glUniform1ui(glGetUniformLocation(prog, "ref_len"), orbit_len);
+    unsigned int *iters = malloc(w * h * sizeof(unsigned int));
+    unsigned int frames = 0;
+    double compute_time = 0.0;
+    char ok = 1;
+
+    if (!job->zoom) {
+        double start = now();
+        compute_view(prog, w, h, &s, s.mag, power, textures[1], iters);
+        compute_time = now() - start;
+        frames = 1;
+        ok = write_still(job->output, w, h, iters, s.max_iters, hue_rgb);
+    }
+    else {
+        // the frames go through an iteration field first. it is what makes a zoom resumable, and it is
+        // left next to the video for recolor
+        char field_filename[MAX_PATH_SIZE + 8];
+        sprintf(field_filename, "%s.itf", job->output);
+        iterfield_context ic;
+        unsigned int done_frames = resume_iter_writer(&ic, field_filename, w, h, s.rec_fps, zoom_key(&s, defines));
+        if (done_frames)
+            printf("job %u: resuming after %u frames.\n", index, done_frames);
+
+        // same steps as rec_start, so the frames line up with the ones already written
+        fe rec_step = fe_set(dd_nth_root(dd_set(s.rec_vel), s.rec_fps).x);
+        unsigned int rec_est = ceil(s.rec_fps * fe_log(fe_div(s.rec_mag, s.mag))/log(s.rec_vel));
+        fe mag = s.mag;
+        char done = !ic.file;
+        for (unsigned int f = 0; f < done_frames && !done; ++f) {
+            done = fe_gt(mag, s.rec_mag) || fe_eq(mag, s.rec_mag);
+            mag = fe_mul(mag, rec_step);
+        }
+
+        double start = now();
+        while (!done) {
+            compute_view(prog, w, h, &s, mag, power, textures[1], iters);
+            write_iter_frame(&ic, iters, s.max_iters, s.max_iters);
+            done = fe_gt(mag, s.rec_mag) || fe_eq(mag, s.rec_mag);
+            mag = fe_mul(mag, rec_step);
+            if (++frames % PROGRESS_FRAMES == 0)
+                printf("job %u: about %u%% done. %u/%u\n", index, ((done_frames + frames) * 100) / rec_est, done_frames + frames, rec_est);
+        }
+        compute_time = now() - start;
+        ok = ic.file != NULL;
+        finalize_iter_writer(&ic);
+
+        if (ok) {
+            char partial[MAX_PATH_SIZE + 16];
+            partial_filename(job->output, partial);
+            ok = encode_iter_field(field_filename, hue_rgb, s.rec_bitrate, partial) && !rename(partial, job->output);
+        }
+    }
+
+    if (frames && compute_time > 0.0)
+        printf("job %u: computed %u frames in %f s. %f frames/s, %f Mpix/s\n", index, frames, compute_time, frames / compute_time, (double)frames * w * h / compute_time * 1e-6);
+
+    free(iters);
+    glDeleteProgram(prog);
+    glDeleteBuffers(1, &stats_buffer);
+    glDeleteBuffers(1, &orbit_buffer);
+    glDeleteTextures(3, textures);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return ok;
+}
+
+unsigned int run_batch(const char *job_filename, unsigned int max_running, char julia, unsigned int power) {
+    char defines[MAX_DEFINES_SIZE];
+    gen_kernel_defines(julia, power, defines);
+
+    FILE *file = fopen(job_filename, "r");
+    if (!file) {
+        fprintf(stderr, "unable to open job file '%s'.\n", job_filename);
+        exit(EXIT_FAILURE);
+    }
+    batch_job *jobs;
+    unsigned int job_count = load_jobs(file, job_filename, &jobs);
+    fclose(file);
+
+    if (!max_running)
+        max_running = 1;
+    pid_t *pids = calloc(job_count, sizeof(pid_t));
+    double *starts = malloc(job_count * sizeof(double));
+    unsigned int next = 0, running = 0, failed = 0, skipped = 0;
+    double batch_start = now();
+    printf("batch: %u jobs, up to %u at a time.\n", job_count, max_running);
+
+    // every job is a separate process with its own context. the gpu interleaves their dispatches while
+    // readback, compression and encoding of one job run on the cpu next to the compute of the others
+    while (next < job_count || running) {
+        while (running < max_running && next < job_count) {
+            const batch_job *job = &jobs[next];
+            if (!access(job->output, F_OK)) {
+                printf("job %u: '%s' exists. skipping.\n", next, job->output);
+                skipped++;
+                next++;
+                continue;
+            }
+
+            fflush(stdout);
+            fflush(stderr);
+            pid_t pid = fork();
+            if (pid < 0) {
+                fprintf(stderr, "job %u: unable to start.\n", next);
+                failed++;
+                next++;
+                continue;
+            }
+            if (!pid)
+                exit(render_job(job, next, julia, power, defines) ? EXIT_SUCCESS : EXIT_FAILURE);
+
+            printf("job %u: started %s of '%s' at %ux%u.\n", next, job->zoom ? "zoom" : "still", job->output, job->width, job->height);
+            pids[next] = pid;
+            starts[next] = now();
+            running++;
+            next++;
+        }
+        if (!running)
+            break;
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+            break;
+        for (unsigned int i = 0; i < next; ++i) {
+            if (pids[i] != pid)
+                continue;
+            char ok = WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+            printf("job %u: %s '%s' after %f s.\n", i, ok ? "finished" : "FAILED", jobs[i].output, now() - starts[i]);
+            failed += !ok;
+            pids[i] = 0;
+            running--;
+            break;
+        }
+    }
+
+    printf("batch done in %f s. %u rendered, %u skipped, %u failed.\n", now() - batch_start, job_count - skipped - failed, skipped, failed);
+    free(jobs);
+    free(pids);
+    free(starts);
+    return failed;
+}
@@ -0,0 +1,19 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// renders the jobs listed in a job file without user interaction. every line is one job:
+//
+//   still <w>x<h> <settings> <palette> <output.ppm>
+//   zoom <w>x<h> <settings> <palette> <output>
+//
+// settings are files written by the save command and palettes are written by save_hue. a still is
+// rendered at the saved view, a zoom runs from the saved mag to rec_set_mag like rec_start does.
+// blank lines and lines starting with # are skipped, w and h must be multiples of 32.
+//
+// up to max_running jobs (-j, 2 by default) run at once, each in its own process with its own gl context. jobs whose
+// output already exists are skipped, and a zoom keeps the frames an interrupted run left in <output>.itf
+// unless its settings or the fractal changed since, so running the same job file again picks up where
+// it stopped. every job renders the fractal given by julia and power. returns the number of failed jobs
+unsigned int run_batch(const char *job_filename, unsigned int max_running, char julia, unsigned int power);
+
+#endif /* BATCH_H */
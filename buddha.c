@@ -0,0 +1,199 @@
+#include "buddha.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define BATCH_SIZE 256
+#define MUTATION_CHANCE 0.8
+#define MUTATION_SIZE 0.05
+
+// xorshift64*
+static unsigned long long next_rng(unsigned long long *s) {
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 0x2545f4914f6cdd1dull;
+}
+
+static double rand_unit(unsigned long long *s) {
+    return (next_rng(s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rand_normal(unsigned long long *s) {
+    double u = rand_unit(s) + 1e-300;
+    double v = rand_unit(s);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+// main cardioid and period 2 bulb never escape
+static char in_main_bulbs(double cx, double cy) {
+    double q = (cx - 0.25) * (cx - 0.25) + cy * cy;
+    if (q * (q + (cx - 0.25)) <= 0.25 * cy * cy)
+        return 1;
+    return (cx + 1.0) * (cx + 1.0) + cy * cy <= 0.0625;
+}
+
+// returns the orbit length if c escapes within max_iters, 0 otherwise
+static unsigned int trace_orbit(double cx, double cy, unsigned int max_iters, double *orbit) {
+    double zx = 0.0, zy = 0.0, z_sqx = 0.0, z_sqy = 0.0;
+    for (unsigned int i = 0; i < max_iters; ++i) {
+        zy = 2.0 * zx * zy + cy;
+        zx = z_sqx - z_sqy + cx;
+        z_sqx = zx * zx;
+        z_sqy = zy * zy;
+        orbit[2 * i] = zx;
+        orbit[2 * i + 1] = zy;
+        if (z_sqx + z_sqy > 4.0)
+            return i + 1;
+    }
+    return 0;
+}
+
+// inverse of the pixel -> c mapping in genset.glsl. returns -1 outside of the view
+static long to_pixel(const buddha_params *p, double zx, double zy) {
+    double x = ((zx - p->offset_x) * p->mag + 0.5) * p->width;
+    double y = ((zy - p->offset_y) * p->mag + 0.5) * p->width;
+    if (x < 0.0 || y < 0.0 || x >= p->width || y >= p->height)
+        return -1;
+    return (long)y * p->width + (long)x;
+}
+
+static unsigned int view_hits(const buddha_params *p, const double *orbit, unsigned int len) {
+    unsigned int hits = 0;
+    for (unsigned int i = 0; i < len; ++i)
+        hits += to_pixel(p, orbit[2 * i], orbit[2 * i + 1]) >= 0;
+    return hits;
+}
+
+static void splat(const buddha_params *p, float *histogram, const double *orbit, unsigned int len, float weight) {
+    for (unsigned int i = 0; i < len; ++i) {
+        long pixel = to_pixel(p, orbit[2 * i], orbit[2 * i + 1]);
+        if (pixel >= 0)
+            histogram[pixel] += weight;
+    }
+}
+
+static void *run_worker(void *arg) {
+    buddha_worker *bw = arg;
+    const buddha_params *p = bw->params;
+
+    double cx = 0.0, cy = 0.0;
+    unsigned int len = 0, hits = 0;
+    double sigma = MUTATION_SIZE / p->mag;
+
+    while (*bw->running) {
+        // mutexes aren't fair, without this the worker would usually relock before a waiting merge wakes up
+        while (bw->merge_pending && *bw->running)
+            sched_yield();
+        pthread_mutex_lock(&bw->lock);
+        for (unsigned int s = 0; s < BATCH_SIZE; ++s) {
+            double nx, ny;
+            if (!p->importance || !hits || rand_unit(&bw->rng) > MUTATION_CHANCE) {
+                nx = rand_unit(&bw->rng) * 4.0 - 2.0;
+                ny = rand_unit(&bw->rng) * 4.0 - 2.0;
+            }
+            else {
+                nx = cx + sigma * rand_normal(&bw->rng);
+                ny = cy + sigma * rand_normal(&bw->rng);
+            }
+
+            unsigned int n_len = 0;
+            if (!in_main_bulbs(nx, ny))
+                n_len = trace_orbit(nx, ny, p->max_iters, bw->orbits[1]);
+            if (n_len < p->min_iters)
+                n_len = 0;
+
+            if (!p->importance) {
+                splat(p, bw->histogram, bw->orbits[1], n_len, 1.0f);
+                continue;
+            }
+
+            // both proposals are symmetric, so the acceptance ratio is just the ratio of view hits.
+            // orbits are splatted with weight 1/hits to undo the bias of sampling proportionally to hits
+            unsigned int n_hits = view_hits(p, bw->orbits[1], n_len);
+            if (rand_unit(&bw->rng) * hits < n_hits) {
+                double *t = bw->orbits[0];
+                bw->orbits[0] = bw->orbits[1];
+                bw->orbits[1] = t;
+                cx = nx;
+                cy = ny;
+                len = n_len;
+                hits = n_hits;
+            }
+            if (hits)
+                splat(p, bw->histogram, bw->orbits[0], len, 1.0f / hits);
+        }
+        bw->samples += BATCH_SIZE;
+        pthread_mutex_unlock(&bw->lock);
+    }
+    return NULL;
+}
+
+void start_buddha(buddha_context *bc, const buddha_params *params, unsigned int worker_count) {
+    bc->params = *params;
+    bc->worker_count = worker_count;
+    bc->workers = malloc(worker_count * sizeof(buddha_worker));
+    bc->density = malloc(params->width * params->height * sizeof(float));
+    bc->running = 1;
+
+    unsigned long long seed = time(NULL);
+    for (unsigned int i = 0; i < worker_count; ++i) {
+        buddha_worker *bw = &bc->workers[i];
+        pthread_mutex_init(&bw->lock, NULL);
+        bw->merge_pending = 0;
+        bw->params = &bc->params;
+        bw->running = &bc->running;
+        bw->histogram = calloc(params->width * params->height, sizeof(float));
+        bw->orbits[0] = malloc(2 * params->max_iters * sizeof(double));
+        bw->orbits[1] = malloc(2 * params->max_iters * sizeof(double));
+        bw->samples = 0;
+        bw->rng = (seed + i) * 0x9e3779b97f4a7c15ull | 1;
+        pthread_create(&bw->thread, NULL, run_worker, bw);
+    }
+}
+
+unsigned long long merge_buddha(buddha_context *bc, unsigned char *image) {
+    unsigned int size = bc->params.width * bc->params.height;
+    unsigned long long samples = 0;
+
+    memset(bc->density, 0, size * sizeof(float));
+    for (unsigned int i = 0; i < bc->worker_count; ++i) {
+        buddha_worker *bw = &bc->workers[i];
+        bw->merge_pending = 1;
+        pthread_mutex_lock(&bw->lock);
+        bw->merge_pending = 0;
+        for (unsigned int j = 0; j < size; ++j)
+            bc->density[j] += bw->histogram[j];
+        samples += bw->samples;
+        pthread_mutex_unlock(&bw->lock);
+    }
+
+    float max = 0.0f;
+    for (unsigned int j = 0; j < size; ++j)
+        if (bc->density[j] > max)
+            max = bc->density[j];
+
+    // sqrt to compress the dynamic range. 255 is left out since it's the interior color of the palette
+    for (unsigned int j = 0; j < size; ++j)
+        image[j] = max > 0.0f ? 254.0f * sqrtf(bc->density[j] / max) : 0;
+
+    return samples;
+}
+
+void stop_buddha(buddha_context *bc) {
+    bc->running = 0;
+    for (unsigned int i = 0; i < bc->worker_count; ++i) {
+        buddha_worker *bw = &bc->workers[i];
+        pthread_join(bw->thread, NULL);
+        pthread_mutex_destroy(&bw->lock);
+        free(bw->histogram);
+        free(bw->orbits[0]);
+        free(bw->orbits[1]);
+    }
+    free(bc->workers);
+    free(bc->density);
+}
@@ -0,0 +1,44 @@
+#ifndef BUDDHA_H
+#define BUDDHA_H
+
+#include <pthread.h>
+
+typedef struct {
+    unsigned int width;
+    unsigned int height;
+    double mag;
+    double offset_x;
+    double offset_y;
+    unsigned int min_iters;
+    unsigned int max_iters;
+    char importance; // metropolis-hastings sampling instead of uniform
+} buddha_params;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock; // held by the worker while it splats a batch, taken by merge_buddha to read the histogram
+    volatile char merge_pending; // set by merge_buddha while it waits for lock, the worker backs off until it gets it
+    const buddha_params *params;
+    const volatile char *running;
+    float *histogram;
+    double *orbits[2]; // interleaved x, y. [0] current orbit, [1] proposal
+    unsigned long long samples;
+    unsigned long long rng;
+} buddha_worker;
+
+typedef struct {
+    buddha_params params;
+    unsigned int worker_count;
+    buddha_worker *workers;
+    float *density;
+    volatile char running;
+} buddha_context;
+
+void start_buddha(buddha_context *bc, const buddha_params *params, unsigned int worker_count);
+
+// sums the per-worker histograms into image (width * height bytes, palette indices). returns the total number of samples taken.
+unsigned long long merge_buddha(buddha_context *bc, unsigned char *image);
+
+void stop_buddha(buddha_context *bc);
+
+#endif /* BUDDHA_H */
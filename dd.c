@@ -0,0 +1,144 @@
+#include "dd.h"
+
+#include <math.h>
+
+// double precision functions
+dd dd_set(double d) {
+    dd t = {d, 0.0};
+    return t;
+}
+
+#ifndef FP_FAST_FMA
+dd dd_split64(double d)
+{
+    // 2^27 + 1 splits the 53 bit mantissa into halves whose products are exact
+    const double SPLITTER = (1 << 27) + 1;
+    double t = d * SPLITTER;
+    dd result;
+    result.x = t - (t - d);
+    result.y = d - result.x;
+
+    return result;
+}
+#endif
+
+dd dd_quick_two_sum(double a, double b)
+{
+    dd temp;
+    temp.x = a + b;
+    temp.y = b - (temp.x - a);
+    return temp;
+}
+
+// with hardware fma the rounding error of a * b is exactly fma(a, b, -a * b)
+dd dd_two_prod(double a, double b) {
+    dd p;
+    p.x = a * b;
+#ifdef FP_FAST_FMA
+    p.y = fma(a, b, -p.x);
+#else
+    dd aS = dd_split64(a);
+    dd bS = dd_split64(b);
+    p.y = (aS.x * bS.x - p.x) + aS.x * bS.y + aS.y * bS.x + aS.y * bS.y;
+#endif
+    return p;
+}
+
+dd dd_add(dd dsa, dd dsb)
+{
+    dd dsc;
+    double t1, t2, e;
+
+    t1 = dsa.x + dsb.x;
+    e = t1 - dsa.x;
+    t2 = ((dsb.x - e) + (dsa.x - (t1 - e))) + dsa.y + dsb.y;
+
+    dsc.x = t1 + t2;
+    dsc.y = t2 - (dsc.x - t1);
+    return dsc;
+}
+
+dd dd_sub(dd dsa, dd dsb) {
+    dd dsb_m = {-dsb.x, -dsb.y};
+    return dd_add(dsa, dsb_m);
+}
+
+dd dd_mul(dd a, dd b)
+{
+    dd p;
+
+    p = dd_two_prod(a.x, b.x);
+    p.y += a.x * b.y + a.y * b.x;
+    p = dd_quick_two_sum(p.x, p.y);
+    return p;
+}
+
+dd dd_div(dd b, dd a) {
+    double xn = 1.0 / a.x;
+    dd yn = {b.x * xn, 0.0};
+    dd a_yn = dd_mul(a, yn);
+    a_yn.x = -a_yn.x;
+    a_yn.y = -a_yn.y;
+
+    double diff = (dd_add(b, a_yn)).x;
+    dd prod = dd_two_prod(xn, diff);
+    return dd_add(yn, prod);
+}
+
+dd dd_abs(dd a) {
+    if (a.x < 0.0 || (a.x == 0.0 && a.y < 0.0)) {
+        a = (dd){-a.x, -a.y};
+    }
+    return a;
+}
+
+char dd_gt(dd a, dd b) {
+     return (a.x > b.x || (a.x == b.x && a.y > b.y));
+}
+
+char dd_eq(dd a, dd b) {
+    return (a.x == b.x && a.y == b.y);
+}
+
+dd dd_nth_pow(dd a, unsigned int n) {
+    if (!n)
+        return dd_set(1.0);
+    dd t = a;
+    while (--n)
+        t = dd_mul(t, a);
+    return t;
+}
+
+dd dd_nth_root(dd a, unsigned int n) {
+    dd x = {1.0/pow(a.x, 1.0/n), 0.0};
+    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) ); // x = x + (x * (1 - ax^n) ) / n
+    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) );
+    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) );
+    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) );
+    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) );
+    return dd_abs(dd_div(dd_set(1.0), x));
+}
+
+void dd_add_batch(const double *ax, const double *ay, const double *bx, const double *by, double *cx, double *cy, unsigned int n) {
+    for (unsigned int i = 0; i < n; ++i) {
+        dd c = dd_add((dd){ax[i], ay[i]}, (dd){bx[i], by[i]});
+        cx[i] = c.x;
+        cy[i] = c.y;
+    }
+}
+
+void dd_mul_batch(const double *ax, const double *ay, const double *bx, const double *by, double *cx, double *cy, unsigned int n) {
+    for (unsigned int i = 0; i < n; ++i) {
+        dd c = dd_mul((dd){ax[i], ay[i]}, (dd){bx[i], by[i]});
+        cx[i] = c.x;
+        cy[i] = c.y;
+    }
+}
+
+void dd_div_batch(const double *ax, const double *ay, const double *bx, const double *by, double *cx, double *cy, unsigned int n) {
+    for (unsigned int i = 0; i < n; ++i) {
+        dd c = dd_div((dd){ax[i], ay[i]}, (dd){bx[i], by[i]});
+        cx[i] = c.x;
+        cy[i] = c.y;
+    }
+}
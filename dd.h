@@ -0,0 +1,28 @@
+#ifndef DD_H
+#define DD_H
+
+typedef struct {
+    double x;
+    double y;
+} dd;
+
+dd dd_set(double d);
+dd dd_quick_two_sum(double a, double b);
+dd dd_two_prod(double a, double b);
+dd dd_add(dd dsa, dd dsb);
+dd dd_sub(dd dsa, dd dsb);
+dd dd_mul(dd a, dd b);
+dd dd_div(dd b, dd a);
+dd dd_abs(dd a);
+char dd_gt(dd a, dd b);
+char dd_eq(dd a, dd b);
+dd dd_nth_pow(dd a, unsigned int n);
+dd dd_nth_root(dd a, unsigned int n);
+
+// batch versions working on n values stored as separate arrays of high (x) and low (y) parts,
+// so that consecutive values sit in consecutive simd lanes. outputs may alias inputs
+void dd_add_batch(const double *ax, const double *ay, const double *bx, const double *by, double *cx, double *cy, unsigned int n);
+void dd_mul_batch(const double *ax, const double *ay, const double *bx, const double *by, double *cx, double *cy, unsigned int n);
+void dd_div_batch(const double *ax, const double *ay, const double *bx, const double *by, double *cx, double *cy, unsigned int n);
+
+#endif /* DD_H */
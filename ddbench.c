@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "dd.h"
+#include "util.h"
+
+#define COUNT (1 << 16)
+#define ROUNDS 200
+
+typedef __float128 quad;
+
+// error bounds in units of 2^-106. add is the sloppy (non-ieee) add, whose error is only bounded
+// relative to |a| + |b|, not to the result, so it is checked against that under cancellation
+#define ADD_BOUND 4.0
+#define MUL_BOUND 8.0
+#define DIV_BOUND 16.0
+
+typedef struct {
+    const char *name;
+    dd (*op)(dd, dd);
+    void (*batch)(const double*, const double*, const double*, const double*, double*, double*, unsigned int);
+    quad (*ref)(quad, quad);
+    char relative_to_inputs;
+    double bound;
+} bench_op;
+
+typedef struct {
+    const char *name;
+    void (*gen)(dd*, dd*);
+} input_range;
+
+static quad q_add(quad a, quad b) { return a + b; }
+static quad q_mul(quad a, quad b) { return a * b; }
+static quad q_div(quad a, quad b) { return a / b; }
+
+static double rand_unit() {
+    return rand() / (RAND_MAX + 1.0);
+}
+
+// random value in [1, 2) with a low part filling the remaining ~53 bits
+static dd rand_dd() {
+    double x = 1.0 + rand_unit();
+    double y = (rand_unit() - 0.5) * ldexp(x, -53);
+    return dd_quick_two_sum(x, y);
+}
+
+static dd scale_dd(dd a, int e, char negate) {
+    double s = negate ? -1.0 : 1.0;
+    return (dd){ s * ldexp(a.x, e), s * ldexp(a.y, e) };
+}
+
+static void gen_positive(dd *a, dd *b) {
+    *a = rand_dd();
+    *b = rand_dd();
+}
+
+// random signs and magnitudes 2^-60 to 2^60 apart
+static void gen_mixed(dd *a, dd *b) {
+    *a = scale_dd(rand_dd(), rand() % 61 - 30, rand() & 1);
+    *b = scale_dd(rand_dd(), rand() % 61 - 30, rand() & 1);
+}
+
+// b is -a up to a relative difference of 2^-1 to 2^-100, so the high parts (and for the
+// closest pairs the low parts too) cancel
+static void gen_cancel(dd *a, dd *b) {
+    *a = scale_dd(rand_dd(), rand() % 21 - 10, rand() & 1);
+    dd d = scale_dd(rand_dd(), -1 - rand() % 100, rand() & 1);
+    *b = dd_sub(dd_set(0.0), dd_add(*a, dd_mul(*a, d)));
+}
+
+static double q_abs(quad q) {
+    return fabs((double)q);
+}
+
+// error of c in units of 2^-106, relative to the result or to |a| + |b|
+static double op_error(const bench_op *op, dd a, dd b, double cx, double cy) {
+    quad qa = (quad)a.x + a.y, qb = (quad)b.x + b.y;
+    quad ref = op->ref(qa, qb);
+    double scale = op->relative_to_inputs ? q_abs(qa) + q_abs(qb) : q_abs(ref);
+    if (scale == 0.0)
+        return cx == 0.0 && cy == 0.0 ? 0.0 : INFINITY;
+    return (double)(((quad)cx + cy - ref) / scale) * 0x1p106;
+}
+
+int main() {
+    double *ax = malloc(COUNT * sizeof(double)), *ay = malloc(COUNT * sizeof(double));
+    double *bx = malloc(COUNT * sizeof(double)), *by = malloc(COUNT * sizeof(double));
+    double *cx = malloc(COUNT * sizeof(double)), *cy = malloc(COUNT * sizeof(double));
+    dd *a = malloc(COUNT * sizeof(dd)), *b = malloc(COUNT * sizeof(dd)), *c = malloc(COUNT * sizeof(dd));
+
+    bench_op ops[] = {
+        { "add", dd_add, dd_add_batch, q_add, 1, ADD_BOUND },
+        { "mul", dd_mul, dd_mul_batch, q_mul, 0, MUL_BOUND },
+        { "div", dd_div, dd_div_batch, q_div, 0, DIV_BOUND },
+    };
+    input_range ranges[] = {
+        { "positive", gen_positive },
+        { "mixed", gen_mixed },
+        { "cancel", gen_cancel },
+    };
+
+#ifdef FP_FAST_FMA
+    printf("two_prod: fma\n");
+#else
+    printf("two_prod: dekker split\n");
+#endif
+    printf("op   range      scalar Mop/s   batch Mop/s   max error (2^-106)   bound\n");
+    unsigned int failures = 0;
+    srand(1);
+    for (unsigned int r = 0; r < sizeof(ranges) / sizeof(*ranges); ++r) {
+        for (unsigned int i = 0; i < COUNT; ++i) {
+            ranges[r].gen(&a[i], &b[i]);
+            ax[i] = a[i].x; ay[i] = a[i].y;
+            bx[i] = b[i].x; by[i] = b[i].y;
+        }
+
+        for (unsigned int o = 0; o < sizeof(ops) / sizeof(*ops); ++o) {
+            double start = now();
+            for (unsigned int k = 0; k < ROUNDS; ++k)
+                for (unsigned int i = 0; i < COUNT; ++i)
+                    c[i] = ops[o].op(a[i], b[i]);
+            double scalar = (double)COUNT * ROUNDS / (now() - start) * 1e-6;
+
+            start = now();
+            for (unsigned int k = 0; k < ROUNDS; ++k)
+                ops[o].batch(ax, ay, bx, by, cx, cy, COUNT);
+            double batch = (double)COUNT * ROUNDS / (now() - start) * 1e-6;
+
+            double max_err = 0.0;
+            for (unsigned int i = 0; i < COUNT; ++i) {
+                max_err = fmax(max_err, fabs(op_error(&ops[o], a[i], b[i], c[i].x, c[i].y)));
+                max_err = fmax(max_err, fabs(op_error(&ops[o], a[i], b[i], cx[i], cy[i])));
+            }
+
+            char ok = max_err <= ops[o].bound;
+            failures += !ok;
+            printf("%s  %-9s %12.1f  %12.1f  %19.3f  %6.1f%s\n", ops[o].name, ranges[r].name, scalar, batch, max_err, ops[o].bound, ok ? "" : "  FAILED");
+        }
+    }
+
+    free(ax); free(ay); free(bx); free(by); free(cx); free(cy);
+    free(a); free(b); free(c);
+    if (failures) {
+        printf("%u checks over their error bound.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("all checks within their error bounds.\n");
+    return EXIT_SUCCESS;
+}
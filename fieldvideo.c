@@ -0,0 +1,42 @@
+#include "fieldvideo.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "record.h"
+#include "palette.h"
+#include "iterfield.h"
+
+char encode_iter_field(const char *filename, const unsigned char hue_rgb[256][3], unsigned int bitrate, const char *output) {
+    iterfield_context ic;
+    if (!open_iter_reader(&ic, filename))
+        return 0;
+
+    unsigned int size = ic.width * ic.height;
+    unsigned int *iters = malloc(size * sizeof(unsigned int));
+    unsigned char *image = malloc(size * 3);
+
+    recorder_context rc;
+    AVRational framerate = { ic.fps, 1 };
+    initialize_recorder(&rc, AV_CODEC_ID_H265, bitrate, framerate, ic.width, ic.height, AV_PIX_FMT_YUV420P, output);
+
+    char ok = 1;
+    unsigned int max_iters, palette_iters;
+    for (unsigned int f = 0; f < ic.frame_count; ++f) {
+        if (!read_iter_frame(&ic, f, iters, &max_iters, &palette_iters)) {
+            fprintf(stderr, "frame %u of '%s' is corrupt. stopping.\n", f, filename);
+            ok = 0;
+            break;
+        }
+        color_iters(iters, size, max_iters, palette_iters, hue_rgb, image);
+        encode_frame(&rc, image);
+        if (f % 20 == 0)
+            printf("about %u%% done. %u/%u\n", (f * 100) / ic.frame_count, f, ic.frame_count);
+    }
+
+    finalize_recorder(&rc);
+    close_iter_reader(&ic);
+    free(iters);
+    free(image);
+    return ok;
+}
@@ -0,0 +1,8 @@
+#ifndef FIELDVIDEO_H
+#define FIELDVIDEO_H
+
+// colors every frame of an iteration field with hue_rgb and encodes it to output through record.c.
+// returns 0 if the field can't be opened or a frame is corrupt
+char encode_iter_field(const char *filename, const unsigned char hue_rgb[256][3], unsigned int bitrate, const char *output);
+
+#endif /* FIELDVIDEO_H */
@@ -0,0 +1,116 @@
+#include "floatexp.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define EXP_MASK (0x7ffull << 52)
+#define EXP_HALF (1022ull << 52)
+
+// brings m into [0.5, 1) by rewriting its exponent bits directly. only subnormals and zero need frexp
+static fe fe_normalize(double m, int e) {
+    unsigned long long bits;
+    memcpy(&bits, &m, sizeof(bits));
+    int biased = (bits & EXP_MASK) >> 52;
+    if (!biased || biased == 0x7ff) {
+        int k;
+        m = frexp(m, &k);
+        return (fe){ m, m == 0.0 ? 0 : e + k };
+    }
+
+    bits = (bits & ~EXP_MASK) | EXP_HALF;
+    memcpy(&m, &bits, sizeof(m));
+    return (fe){ m, e + biased - 1022 };
+}
+
+fe fe_set(double d) {
+    return fe_normalize(d, 0);
+}
+
+fe fe_ldexp(fe a, int e) {
+    if (a.m == 0.0)
+        return a;
+    return (fe){ a.m, a.e + e };
+}
+
+fe fe_add(fe a, fe b) {
+    if (a.m == 0.0)
+        return b;
+    if (b.m == 0.0)
+        return a;
+    // past 64 binades the smaller one is below the last bit of the larger one
+    if (a.e - b.e > 64)
+        return a;
+    if (b.e - a.e > 64)
+        return b;
+    if (a.e >= b.e)
+        return fe_normalize(a.m + ldexp(b.m, b.e - a.e), a.e);
+    return fe_normalize(ldexp(a.m, a.e - b.e) + b.m, b.e);
+}
+
+fe fe_sub(fe a, fe b) {
+    b.m = -b.m;
+    return fe_add(a, b);
+}
+
+fe fe_mul(fe a, fe b) {
+    return fe_normalize(a.m * b.m, a.e + b.e);
+}
+
+fe fe_div(fe a, fe b) {
+    return fe_normalize(a.m / b.m, a.e - b.e);
+}
+
+char fe_gt(fe a, fe b) {
+    return fe_sub(a, b).m > 0.0;
+}
+
+char fe_eq(fe a, fe b) {
+    return a.m == b.m && a.e == b.e;
+}
+
+double fe_log(fe a) {
+    return log(a.m) + a.e * M_LN2;
+}
+
+double fe_to_double(fe a) {
+    return ldexp(a.m, a.e);
+}
+
+void fe_sprint(char *buffer, fe a) {
+    if (a.m == 0.0) {
+        sprintf(buffer, "0");
+        return;
+    }
+    double l = log10(fabs(a.m)) + a.e * log10(2.0);
+    double exponent = floor(l);
+    double mantissa = pow(10.0, l - exponent);
+    // %f rounds to 6 places, a mantissa that rounds up to 10 belongs to the next decade
+    if (mantissa >= 9.9999995) {
+        mantissa /= 10.0;
+        exponent += 1.0;
+    }
+    sprintf(buffer, "%s%fe%.0f", a.m < 0.0 ? "-" : "", mantissa, exponent);
+}
+
+void fe_print_hex(char *buffer, fe a) {
+    unsigned long long bits;
+    memcpy(&bits, &a.m, sizeof(bits));
+    sprintf(buffer, "%.16llxe%d", bits, a.e);
+}
+
+char fe_scan_hex(const char *s, fe *a) {
+    unsigned long long bits;
+    int n, e = 0;
+    if (!s || sscanf(s, "%16llx%n", &bits, &n) != 1)
+        return 0;
+    s += n;
+    if (strspn(s, "0123456789abcdefABCDEF") >= 16)
+        s += 16;
+    // no exponent in files saved before mag was a floatexp
+    sscanf(s, "e%d", &e);
+    double m;
+    memcpy(&m, &bits, sizeof(m));
+    *a = fe_ldexp(fe_set(m), e);
+    return 1;
+}
@@ -0,0 +1,35 @@
+#ifndef FLOATEXP_H
+#define FLOATEXP_H
+
+// double mantissa with a separate exponent, value = m * 2^e with 0.5 <= |m| < 1 (or m = 0).
+// keeps zoom bookkeeping (mag, recording end and step, frame estimates) finite past the range of double.
+// only 53 bits of mantissa, a dd value converted to fe loses its low word
+typedef struct {
+    double m;
+    int e;
+} fe;
+
+fe fe_set(double d);
+fe fe_ldexp(fe a, int e);
+fe fe_add(fe a, fe b);
+fe fe_sub(fe a, fe b);
+fe fe_mul(fe a, fe b);
+fe fe_div(fe a, fe b);
+char fe_gt(fe a, fe b);
+char fe_eq(fe a, fe b);
+
+// natural log, finite for any positive value
+double fe_log(fe a);
+
+// saturates to inf / 0 outside the range of double
+double fe_to_double(fe a);
+
+// prints as "<mantissa>e<decimal exponent>", e.g. 1.234567e-512
+void fe_sprint(char *buffer, fe a);
+
+// exact text form used by settings files, the bits of m as 16 hex digits then e<binary exponent>.
+// fe_scan_hex also takes the older dd form with 32 hex digits (the low word is dropped). returns 0 on bad input
+void fe_print_hex(char *buffer, fe a);
+char fe_scan_hex(const char *s, fe *a);
+
+#endif /* FLOATEXP_H */
@@ -8,10 +8,31 @@ out vec4 color;
 uniform sampler2D text;
 uniform vec3 hue[256];
 uniform int current_mode;
+// maps the current view onto the view the texture was computed for, so an older image can be shown while the new one computes
+uniform vec2 view_scale;
+uniform vec2 view_shift;
+
+// per pixel iteration counts from the compute shader, shown instead of the palette when heatmap is set
+uniform usampler2D work;
+uniform int heatmap;
+uniform float heat_max;
+
+// black -> red -> yellow -> white, log scaled so cheap pixels are still told apart
+vec3 heat(uint w) {
+    float t = log(1.0f + float(w)) / log(1.0f + heat_max);
+    return clamp(vec3(3.0f * t, 3.0f * t - 1.0f, 3.0f * t - 2.0f), 0.0f, 1.0f);
+}
 
 void main() {
-    if (current_mode == MOVE)
-        color = vec4(hue[int(floor(texture(text, TexCoord).r * 255))].rgb, 1.0f);
+    if (current_mode == MOVE && heatmap != 0)
+        color = vec4(heat(texture(work, TexCoord).r), 1.0f);
+    else if (current_mode == MOVE) {
+        vec2 coord = (TexCoord - 0.5f) * view_scale + 0.5f + view_shift;
+        if (any(lessThan(coord, vec2(0.0f))) || any(greaterThan(coord, vec2(1.0f))))
+            color = vec4(hue[0].rgb, 1.0f);
+        else
+            color = vec4(hue[int(floor(texture(text, coord).r * 255))].rgb, 1.0f);
+    }
     else if (current_mode == HUE)
         color = vec4(hue[int(TexCoord.x * 255) % 255].rgb, 1.0f);
 }
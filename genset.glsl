@@ -2,15 +2,51 @@
 layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
 
 layout (r8ui, binding = 0) uniform uimage2D img;
+// unquantized escape counts, for recording iteration fields
+layout (r32ui, binding = 2) uniform uimage2D iter_img;
 
 uniform unsigned int max_iters;
-uniform dvec2 mag;
+// one cycle of the palette spans palette_iters escape iterations. it stays put while max_iters is tuned, so tuning
+// the limit doesn't recolor the view
+uniform unsigned int palette_iters;
+// mag = mag_m * 2^mag_exp, a floatexp. the pixel spacing stays exact at any depth, but dd coordinates (offset plus
+// delta) only resolve it down to about 2^-104. deeper views go through perturb_iters, for power 2 only
+uniform double mag_m;
+uniform int mag_exp;
 uniform dvec2 offsetx;
 uniform dvec2 offsety;
 
 uniform unsigned int antialiasing;
+// the image is computed in slices of rows, this is the first row of the current slice
+uniform unsigned int row_offset;
 
-const double SPLITTER = (1 << 29) + 1;
+// iterations executed for each pixel, summed over all aa subsamples
+layout (r32ui, binding = 3) uniform uimage2D work_img;
+
+// per 32x32 tile: pixels that hit max_iters, highest escape iteration, iterations executed and the part
+// of those spent on extra aa subsamples (both as 64 bit lo, hi pairs), then a histogram of escape
+// iterations in STAT_BINS equal bins of [0, max_iters). read back to tune max_iters and report work
+#define STAT_LIMIT 0
+#define STAT_MAX 1
+#define STAT_WORK 2
+#define STAT_AA_WORK 4
+#define STAT_HIST 6
+#define STAT_BINS 16
+#define TILE_STATS_SIZE (STAT_HIST + STAT_BINS)
+layout (std430, binding = 1) buffer tile_stats {
+    uint stats[];
+};
+shared uint tile_limit;
+shared uint tile_max;
+shared uint tile_work[4];
+shared uint tile_bins[STAT_BINS];
+
+// shared memory has no 64 bit atomics, carry into the high word by hand
+void add_work(uint index, uint work) {
+    uint old = atomicAdd(tile_work[index], work);
+    if (old + work < old)
+        atomicAdd(tile_work[index + 1], 1u);
+}
 
 
 precise dvec2 ds_set(double a)
@@ -43,22 +79,11 @@ precise dvec2 quick_two_sum(precise double a, precise double b)
     return temp;
 }
 
-dvec2 Split64(double d)
-{
-    double t = d * SPLITTER;
-    dvec2 result;
-    result.x = t - (t - d);
-    result.y = d - result.x;
-
-    return result;
-}
-
+// fma rounds only once, so it gives the exact rounding error of a * b
 precise dvec2 twoProd(precise double a, precise double b) {
     precise dvec2 p;
     p.x = a * b;
-    precise dvec2 aS = Split64(a);
-    precise dvec2 bS = Split64(b);
-    p.y = (aS.x * bS.x - p.x) + aS.x * bS.y + aS.y * bS.x + aS.y * bS.y;
+    p.y = fma(a, b, -p.x);
     return p;
 }
 
@@ -81,16 +106,32 @@ precise dvec2 ds_div(precise dvec2 b, precise dvec2 a) {
     return ds_add(dvec2(yn, 0.0), prod);
 }
 
-precise unsigned int escape_iters(dvec2 cx, dvec2 cy, unsigned int m_iters) {
-    dvec2 zx = dvec2(0.0, 0.0);
-    dvec2 zy = dvec2(0.0, 0.0);
-    dvec2 z_sqx = dvec2(0.0, 0.0);
-    dvec2 z_sqy = dvec2(0.0, 0.0);
+// JULIA and POWER are defined by the host when the kernel is compiled. for POWER > 2 the host
+// also defines Z_POW(zx, zy, z_sqx, z_sqy) as the unrolled square-and-multiply chain computing z^POWER in place,
+// reusing the squares from the bailout test
+#ifndef POWER
+#define POWER 2
+#endif
+
+#ifdef JULIA
+uniform dvec2 julia_cx;
+uniform dvec2 julia_cy;
+#endif
+
+precise unsigned int escape_iters(dvec2 zx, dvec2 zy, dvec2 cx, dvec2 cy, unsigned int m_iters) {
+    dvec2 z_sqx = ds_mul(zx, zx);
+    dvec2 z_sqy = ds_mul(zy, zy);
 
     unsigned int i;
     for (i = 0; i < m_iters && z_sqx.x + z_sqy.x < 4.0; i++) {
+#if POWER == 2
         zy = ds_add(ds_mul(ds_add(zx, zx), zy), cy);
         zx = ds_add(ds_add(z_sqx, -z_sqy), cx);
+#else
+        Z_POW(zx, zy, z_sqx, z_sqy)
+        zx = ds_add(zx, cx);
+        zy = ds_add(zy, cy);
+#endif
 
         z_sqx = ds_mul(zx, zx);
         z_sqy = ds_mul(zy, zy);
@@ -98,29 +139,169 @@ precise unsigned int escape_iters(dvec2 cx, dvec2 cy, unsigned int m_iters) {
     return i;
 }
 
+precise unsigned int pixel_iters(dvec2 px, dvec2 py, unsigned int m_iters) {
+#ifdef JULIA
+    return escape_iters(px, py, julia_cx, julia_cy, m_iters);
+#else
+    return escape_iters(dvec2(0.0, 0.0), dvec2(0.0, 0.0), px, py, m_iters);
+#endif
+}
+
+// offset of a pixel from the view center, t being the pixel coordinate in units of the image width.
+// underflows to 0 past mag ~1e308, long after the dd offset stopped resolving it
+precise dvec2 pixel_delta(double t) {
+    precise dvec2 d = ds_div(ds_set(t - 0.5), ds_set(mag_m));
+    return dvec2(ldexp(d.x, -mag_exp), ldexp(d.y, -mag_exp));
+}
+
+#if POWER == 2
+// set by the host past PERTURB_BITS (see perturb.h). pixels are then iterated as deltas from a reference orbit
+// of the view center, which the host computes in dd and stores as Z_0 .. Z_{ref_len - 1}
+uniform unsigned int perturb;
+uniform unsigned int ref_len;
+layout (std430, binding = 4) readonly buffer ref_orbit {
+    dvec2 ref[];
+};
+
+// complex floatexp, value = m * 2^e with the larger of |m.x|, |m.y| in [0.5, 1). deltas are far below the
+// range of double at depth, only their sum with the reference orbit is taken back to double
+struct fec {
+    dvec2 m;
+    int e;
+};
+#define FEC_ZERO_EXP (-(1 << 29))
+
+fec fec_norm(dvec2 m, int e) {
+    double a = max(abs(m.x), abs(m.y));
+    if (a == 0.0)
+        return fec(dvec2(0.0), FEC_ZERO_EXP);
+    int k;
+    frexp(a, k);
+    return fec(ldexp(m, ivec2(-k)), e + k);
+}
+
+fec fec_add(fec a, fec b) {
+    if (a.e < b.e) {
+        fec t = a;
+        a = b;
+        b = t;
+    }
+    // past 64 binades b is below the last bit of a
+    if (b.e - a.e < -64)
+        return a;
+    return fec_norm(a.m + ldexp(b.m, ivec2(b.e - a.e)), a.e);
+}
+
+fec fec_mul(fec a, fec b) {
+    return fec_norm(dvec2(a.m.x * b.m.x - a.m.y * b.m.y, a.m.x * b.m.y + a.m.y * b.m.x), a.e + b.e);
+}
+
+// ldexp is undefined far below the double range, anything under 2^-1100 is 0 anyway
+dvec2 fec_to_double(fec a) {
+    return ldexp(a.m, ivec2(max(a.e, -1100)));
+}
+
+// z = Z_m + dz, c = C + dc. dz' = (2 Z_m + dz) dz + dc keeps the pixel on the reference without ever forming z
+// at full precision. once z gets smaller than dz, or the reference runs out, dz is moved back to the start of
+// the reference (zhuoran's rebasing), so one reference orbit serves every pixel of the view
+unsigned int perturb_iters(fec dz, fec dc, unsigned int m_iters) {
+    unsigned int m = 0;
+    unsigned int i;
+    for (i = 0; i < m_iters; i++) {
+        dvec2 d = fec_to_double(dz);
+        dvec2 z = ref[m] + d;
+        double z_sq = z.x * z.x + z.y * z.y;
+        if (z_sq >= 4.0)
+            break;
+        if (z_sq < d.x * d.x + d.y * d.y || m == ref_len - 1) {
+            dz = fec_add(fec_norm(ref[m] - ref[0], 0), dz);
+            m = 0;
+        }
+        dz = fec_add(fec_mul(fec_add(fec_norm(2.0 * ref[m], 0), dz), dz), dc);
+        m++;
+    }
+    return i;
+}
+#endif
+
+// escape iterations of the sample at t, the pixel coordinates in units of the image width
+precise unsigned int sample_iters(dvec2 t, unsigned int m_iters) {
+#if POWER == 2
+    if (perturb != 0u) {
+        fec d = fec_norm((t - 0.5) / mag_m, -mag_exp);
+#ifdef JULIA
+        return perturb_iters(d, fec(dvec2(0.0), FEC_ZERO_EXP), m_iters);
+#else
+        return perturb_iters(fec(dvec2(0.0), FEC_ZERO_EXP), d, m_iters);
+#endif
+    }
+#endif
+    dvec2 new_coordx = ds_add(pixel_delta(t.x), ds_set(0.5));
+    dvec2 new_coordy = ds_add(pixel_delta(t.y), ds_set(0.5));
+    dvec2 cx = ds_add(new_coordx, ds_add(offsetx, ds_set(-0.5)));
+    dvec2 cy = ds_add(new_coordy, ds_add(offsety, ds_set(-0.5)));
+    return pixel_iters(cx, cy, m_iters);
+}
+
 precise void main() {
-    if (antialiasing < 2) {
-        dvec2 new_coordx = ds_add(ds_div(ds_set(double(gl_GlobalInvocationID.x)/imageSize(img).x - 0.5), mag), ds_set(0.5));
-        dvec2 new_coordy = ds_add(ds_div(ds_set(double(gl_GlobalInvocationID.y)/imageSize(img).x - 0.5), mag), ds_set(0.5));
-        dvec2 cx = ds_add(new_coordx, ds_add(offsetx, ds_set(-0.5)));
-        dvec2 cy = ds_add(new_coordy, ds_add(offsety, ds_set(-0.5)));
-        unsigned int iters = escape_iters(cx, cy, max_iters);
+    uvec2 pixel = gl_GlobalInvocationID.xy + uvec2(0, row_offset);
+    if (gl_LocalInvocationIndex == 0) {
+        tile_limit = 0;
+        tile_max = 0;
+        for (int i = 0; i < 4; ++i)
+            tile_work[i] = 0;
+        for (int i = 0; i < STAT_BINS; ++i)
+            tile_bins[i] = 0;
+    }
+    barrier();
 
-        imageStore(img, ivec2(gl_GlobalInvocationID.xy), uvec4(int(iters/float(max_iters) * 255), 0, 0, 255));
+    unsigned int iters;
+    unsigned int work;
+    unsigned int aa_work = 0;
+    if (antialiasing < 2) {
+        iters = sample_iters(dvec2(pixel) / imageSize(img).x, max_iters);
+        work = iters;
     }
     else {
-        unsigned int lowest_iters = max_iters;
+        iters = max_iters;
+        work = 0;
         for (unsigned int x = 0; x < antialiasing; ++x) {
             for (unsigned int y = 0; y < antialiasing; ++y) {
-                dvec2 new_coordx = ds_add(ds_div(ds_set(double(gl_GlobalInvocationID.x + x * 1.0/antialiasing)/imageSize(img).x - 0.5), mag), ds_set(0.5));
-                dvec2 new_coordy = ds_add(ds_div(ds_set(double(gl_GlobalInvocationID.y + y * 1.0/antialiasing)/imageSize(img).x - 0.5), mag), ds_set(0.5));
-                dvec2 cx = ds_add(new_coordx, ds_add(offsetx, ds_set(-0.5)));
-                dvec2 cy = ds_add(new_coordy, ds_add(offsety, ds_set(-0.5)));
-                unsigned int iters = escape_iters(cx, cy, lowest_iters);
-                lowest_iters = min(lowest_iters, iters);
+                dvec2 t = (dvec2(pixel) + dvec2(x, y) * (1.0/antialiasing)) / imageSize(img).x;
+                unsigned int sub_iters = sample_iters(t, iters);
+                work += sub_iters;
+                if (x > 0 || y > 0)
+                    aa_work += sub_iters;
+                iters = min(iters, sub_iters);
             }
         }
+    }
+
+    // 255 is the interior color. escapes cycle through 0..254 every palette_iters iterations, so escapes past
+    // palette_iters keep getting colors instead of piling up at the end. same formula as color_iters in palette.c
+    uint index = iters >= max_iters ? 255u : uint(double(iters % palette_iters) * 255.0 / double(palette_iters));
+    imageStore(img, ivec2(pixel), uvec4(index, 0, 0, 255));
+    imageStore(iter_img, ivec2(pixel), uvec4(iters, 0, 0, 0));
+    imageStore(work_img, ivec2(pixel), uvec4(work, 0, 0, 0));
+
+    add_work(0, work);
+    add_work(2, aa_work);
+
+    if (iters >= max_iters)
+        atomicAdd(tile_limit, 1u);
+    else {
+        atomicMax(tile_max, iters);
+        atomicAdd(tile_bins[min(uint(double(iters) * STAT_BINS / max_iters), uint(STAT_BINS - 1))], 1u);
+    }
+    barrier();
 
-        imageStore(img, ivec2(gl_GlobalInvocationID.xy), uvec4(int(lowest_iters/float(max_iters) * 255), 0, 0, 255));
+    if (gl_LocalInvocationIndex == 0) {
+        uint tile = ((pixel.y / gl_WorkGroupSize.y) * gl_NumWorkGroups.x + gl_WorkGroupID.x) * TILE_STATS_SIZE;
+        stats[tile + STAT_LIMIT] = tile_limit;
+        stats[tile + STAT_MAX] = tile_max;
+        for (int i = 0; i < 4; ++i)
+            stats[tile + STAT_WORK + i] = tile_work[i];
+        for (int i = 0; i < STAT_BINS; ++i)
+            stats[tile + STAT_HIST + i] = tile_bins[i];
     }
 }
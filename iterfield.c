@@ -0,0 +1,215 @@
+#include "iterfield.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define HEADER_MAGIC "ITF3"
+#define INDEX_MAGIC "ITFX"
+#define HEADER_SIZE 24
+#define FOOTER_SIZE 16
+// frame header: max_iters, palette_iters, compressed size (u32 each)
+#define FRAME_COMPRESSED 2
+
+static void allocate_buffers(iterfield_context *ic) {
+    ic->deltas = malloc(ic->width * ic->height * sizeof(unsigned int));
+    ic->compressed_capacity = compressBound(ic->width * ic->height * sizeof(unsigned int));
+    ic->compressed = malloc(ic->compressed_capacity);
+}
+
+static void add_offset(iterfield_context *ic, unsigned long long offset) {
+    if (ic->frame_count == ic->frame_capacity) {
+        ic->frame_capacity = ic->frame_capacity ? ic->frame_capacity * 2 : 256;
+        ic->offsets = realloc(ic->offsets, ic->frame_capacity * sizeof(unsigned long long));
+    }
+    ic->offsets[ic->frame_count++] = offset;
+}
+
+void initialize_iter_writer(iterfield_context *ic, const char *filename, unsigned int width, unsigned int height, unsigned int fps, unsigned long long key) {
+    memset(ic, 0, sizeof(*ic));
+    ic->width = width;
+    ic->height = height;
+    ic->fps = fps;
+    ic->key = key;
+    allocate_buffers(ic);
+
+    ic->file = fopen(filename, "wb");
+    if (!ic->file) {
+        fprintf(stderr, "unable to open iteration field '%s'.\n", filename);
+        return;
+    }
+    fwrite(HEADER_MAGIC, 4, 1, ic->file);
+    fwrite(&width, sizeof(width), 1, ic->file);
+    fwrite(&height, sizeof(height), 1, ic->file);
+    fwrite(&fps, sizeof(fps), 1, ic->file);
+    fwrite(&key, sizeof(key), 1, ic->file);
+}
+
+void write_iter_frame(iterfield_context *ic, const unsigned int *iters, unsigned int max_iters, unsigned int palette_iters) {
+    if (!ic->file)
+        return;
+
+    // neighbouring counts are close, so row deltas are mostly tiny and deflate well
+    for (unsigned int y = 0; y < ic->height; ++y) {
+        const unsigned int *row = iters + y * ic->width;
+        unsigned int *out = ic->deltas + y * ic->width;
+        out[0] = row[0];
+        for (unsigned int x = 1; x < ic->width; ++x)
+            out[x] = row[x] - row[x - 1];
+    }
+
+    uLongf size = ic->compressed_capacity;
+    compress2(ic->compressed, &size, (const Bytef*)ic->deltas, ic->width * ic->height * sizeof(unsigned int), Z_BEST_SPEED);
+
+    add_offset(ic, ftell(ic->file));
+    unsigned int frame_header[3] = { max_iters, palette_iters, size };
+    fwrite(frame_header, sizeof(frame_header), 1, ic->file);
+    fwrite(ic->compressed, size, 1, ic->file);
+}
+
+void finalize_iter_writer(iterfield_context *ic) {
+    if (ic->file) {
+        unsigned long long index_offset = ftell(ic->file);
+        fwrite(ic->offsets, sizeof(unsigned long long), ic->frame_count, ic->file);
+        fwrite(&ic->frame_count, sizeof(ic->frame_count), 1, ic->file);
+        fwrite(&index_offset, sizeof(index_offset), 1, ic->file);
+        fwrite(INDEX_MAGIC, 4, 1, ic->file);
+        fclose(ic->file);
+    }
+    free(ic->offsets);
+    free(ic->deltas);
+    free(ic->compressed);
+}
+
+static char read_index(iterfield_context *ic) {
+    fseek(ic->file, 0, SEEK_END);
+    long end = ftell(ic->file);
+    if (end < HEADER_SIZE + FOOTER_SIZE)
+        return 0;
+
+    unsigned int count;
+    unsigned long long index_offset;
+    char magic[4];
+    fseek(ic->file, end - FOOTER_SIZE, SEEK_SET);
+    if (fread(&count, sizeof(count), 1, ic->file) != 1 || fread(&index_offset, sizeof(index_offset), 1, ic->file) != 1 || fread(magic, 4, 1, ic->file) != 1)
+        return 0;
+    if (memcmp(magic, INDEX_MAGIC, 4) || index_offset + count * sizeof(unsigned long long) + FOOTER_SIZE != (unsigned long long)end)
+        return 0;
+
+    ic->frame_count = ic->frame_capacity = count;
+    ic->offsets = malloc(count * sizeof(unsigned long long));
+    fseek(ic->file, index_offset, SEEK_SET);
+    return fread(ic->offsets, sizeof(unsigned long long), count, ic->file) == count;
+}
+
+// walks the frames one by one, stopping at the first incomplete one
+static void scan_frames(iterfield_context *ic) {
+    free(ic->offsets);
+    ic->offsets = NULL;
+    ic->frame_count = ic->frame_capacity = 0;
+
+    fseek(ic->file, 0, SEEK_END);
+    long end = ftell(ic->file);
+    long offset = HEADER_SIZE;
+    unsigned int frame_header[3];
+    fseek(ic->file, offset, SEEK_SET);
+    while (fread(frame_header, sizeof(frame_header), 1, ic->file) == 1) {
+        long next = offset + sizeof(frame_header) + frame_header[FRAME_COMPRESSED];
+        if (next > end || !frame_header[FRAME_COMPRESSED] || frame_header[FRAME_COMPRESSED] > ic->compressed_capacity)
+            break;
+        add_offset(ic, offset);
+        offset = next;
+        fseek(ic->file, offset, SEEK_SET);
+    }
+}
+
+char open_iter_reader(iterfield_context *ic, const char *filename) {
+    memset(ic, 0, sizeof(*ic));
+    ic->file = fopen(filename, "rb");
+    if (!ic->file)
+        return 0;
+
+    char magic[4];
+    if (fread(magic, 4, 1, ic->file) != 1 || memcmp(magic, HEADER_MAGIC, 4) ||
+            fread(&ic->width, sizeof(ic->width), 1, ic->file) != 1 ||
+            fread(&ic->height, sizeof(ic->height), 1, ic->file) != 1 ||
+            fread(&ic->fps, sizeof(ic->fps), 1, ic->file) != 1 ||
+            fread(&ic->key, sizeof(ic->key), 1, ic->file) != 1) {
+        fclose(ic->file);
+        return 0;
+    }
+    allocate_buffers(ic);
+
+    if (!read_index(ic))
+        scan_frames(ic);
+    return 1;
+}
+
+char read_iter_frame(iterfield_context *ic, unsigned int index, unsigned int *iters, unsigned int *max_iters, unsigned int *palette_iters) {
+    if (index >= ic->frame_count)
+        return 0;
+
+    unsigned int frame_header[3];
+    fseek(ic->file, ic->offsets[index], SEEK_SET);
+    if (fread(frame_header, sizeof(frame_header), 1, ic->file) != 1 || frame_header[FRAME_COMPRESSED] > ic->compressed_capacity)
+        return 0;
+    if (fread(ic->compressed, frame_header[FRAME_COMPRESSED], 1, ic->file) != 1)
+        return 0;
+
+    uLongf size = ic->width * ic->height * sizeof(unsigned int);
+    if (uncompress((Bytef*)iters, &size, ic->compressed, frame_header[FRAME_COMPRESSED]) != Z_OK || size != ic->width * ic->height * sizeof(unsigned int))
+        return 0;
+
+    for (unsigned int y = 0; y < ic->height; ++y) {
+        unsigned int *row = iters + y * ic->width;
+        for (unsigned int x = 1; x < ic->width; ++x)
+            row[x] += row[x - 1];
+    }
+    *max_iters = frame_header[0];
+    *palette_iters = frame_header[1];
+    return 1;
+}
+
+void close_iter_reader(iterfield_context *ic) {
+    fclose(ic->file);
+    free(ic->offsets);
+    free(ic->deltas);
+    free(ic->compressed);
+}
+
+unsigned int resume_iter_writer(iterfield_context *ic, const char *filename, unsigned int width, unsigned int height, unsigned int fps, unsigned long long key) {
+    if (!open_iter_reader(ic, filename)) {
+        initialize_iter_writer(ic, filename, width, height, fps, key);
+        return 0;
+    }
+    if (ic->width != width || ic->height != height || ic->fps != fps || ic->key != key) {
+        if (ic->frame_count)
+            printf("iteration field '%s' was written with different settings. starting over.\n", filename);
+        close_iter_reader(ic);
+        initialize_iter_writer(ic, filename, width, height, fps, key);
+        return 0;
+    }
+
+    // new frames go where the index (if any) was
+    long end = HEADER_SIZE;
+    unsigned int frame_header[3];
+    while (ic->frame_count) {
+        fseek(ic->file, ic->offsets[ic->frame_count - 1], SEEK_SET);
+        if (fread(frame_header, sizeof(frame_header), 1, ic->file) == 1) {
+            end = ic->offsets[ic->frame_count - 1] + sizeof(frame_header) + frame_header[FRAME_COMPRESSED];
+            break;
+        }
+        ic->frame_count--;
+    }
+    fclose(ic->file);
+
+    if (truncate(filename, end) || !(ic->file = fopen(filename, "r+b"))) {
+        fprintf(stderr, "unable to resume iteration field '%s'.\n", filename);
+        ic->file = NULL;
+        return 0;
+    }
+    fseek(ic->file, 0, SEEK_END);
+    return ic->frame_count;
+}
@@ -0,0 +1,53 @@
+#ifndef ITERFIELD_H
+#define ITERFIELD_H
+
+#include <stdio.h>
+
+// iteration field files keep the raw 32 bit escape counts of every recorded frame so a zoom can be
+// re-colored without recomputing it.
+//
+// layout (native byte order):
+//   header:  "ITF3", width, height, fps (u32 each), key (u64)
+//   frame:   max_iters, palette_iters, compressed size (u32), deflated row deltas
+//   index:   frame offsets (u64 each), frame count (u32), index offset (u64), "ITFX"
+//
+// key is whatever the writer uses to tell which frames a file holds (0 if unused). batch jobs store a
+// hash of their settings in it so a changed job doesn't resume from stale frames.
+//
+// frames can be read sequentially while the file is still being written. the index at the end makes
+// it seekable, and a file missing it (e.g. after a crash) is indexed by scanning the frames
+typedef struct {
+    FILE *file;
+    unsigned int width;
+    unsigned int height;
+    unsigned int fps;
+    unsigned long long key;
+    unsigned int frame_count;
+    unsigned int frame_capacity;
+    unsigned long long *offsets;
+    unsigned int *deltas;
+    unsigned char *compressed;
+    unsigned long compressed_capacity;
+} iterfield_context;
+
+void initialize_iter_writer(iterfield_context *ic, const char *filename, unsigned int width, unsigned int height, unsigned int fps, unsigned long long key);
+
+// iters holds width * height counts, rows bottom to top like glReadPixels. max_iters is the limit the frame
+// was computed with, palette_iters the span of the palette (see genset.glsl)
+void write_iter_frame(iterfield_context *ic, const unsigned int *iters, unsigned int max_iters, unsigned int palette_iters);
+
+void finalize_iter_writer(iterfield_context *ic);
+
+// continues writing a field left behind by an interrupted run. the file is cut after its last complete frame
+// and the number of frames kept is returned. a missing file, or one with another size, fps or key, is started over
+unsigned int resume_iter_writer(iterfield_context *ic, const char *filename, unsigned int width, unsigned int height, unsigned int fps, unsigned long long key);
+
+// returns 0 if the file can't be opened or isn't an iteration field
+char open_iter_reader(iterfield_context *ic, const char *filename);
+
+// returns 0 if the frame is out of range or corrupt
+char read_iter_frame(iterfield_context *ic, unsigned int index, unsigned int *iters, unsigned int *max_iters, unsigned int *palette_iters);
+
+void close_iter_reader(iterfield_context *ic);
+
+#endif /* ITERFIELD_H */
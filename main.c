@@ -5,279 +5,124 @@
 #include <assert.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "record.h"
+#include "buddha.h"
+#include "dd.h"
+#include "floatexp.h"
+#include "shader.h"
+#include "palette.h"
+#include "iterfield.h"
+#include "perturb.h"
+#include "batch.h"
+#include "util.h"
 
 #define MAX_COMMAND_SIZE 512
-#define MAX_INTERVAL_COUNT 100
-#define MAX_PATH_SIZE 1024
+// default for -j. the jobs share one gpu, so more of them don't compute faster. a second one keeps it busy
+// while the first reads back, compresses or encodes its frames on the cpu, more only add memory and contention
+#define BATCH_JOBS 2
+#define BUDDHA_REFRESH_TIME 0.5
+#define SLICE_TIME 0.008
+#define TOP_TILES 5
+#define AUTO_ITERS_MIN 64
+#define AUTO_ITERS_PASSES 4
+#define AUTO_ITERS_REC_GROWTH 10
+// pixel coordinates are the dd offset plus a delta, and dd holds about 104 bits. once a pixel is smaller than
+// that relative to the offset, neighbouring pixels compute the same point. only powers above 2 get there,
+// power 2 switches to perturbation long before
+#define DD_RESOLVE_BITS 104
 
 void error_callback(int error, const char* description) {
     fprintf(stderr, "glfw error: %s\n", description);
     exit(EXIT_FAILURE);
 }
 
-unsigned int compile_render_shaders(const char *vert_filepath, const char *frag_filepath) {
-    FILE *vert_file = fopen(vert_filepath, "r");
-    if (!vert_file) {
-        int error = errno;
-        fprintf(stderr, "unable to load vertex shader at '%s'.\nerror: %s", vert_filepath, strerror(error));
-        exit(EXIT_FAILURE);
+// picks the iteration limit for a view from the per tile stats genset.glsl wrote while computing it with max_iters.
+// if a noticeable share of escapes lands in the last bin, the boundary is being cut off and the limit doubles.
+// otherwise it is pulled down to a margin above the slowest escape, which leaves every pixel classified the same
+// but stops interior pixels from burning iterations
+unsigned int tune_iters(const unsigned int *stats, unsigned int tile_count, unsigned int max_iters) {
+    unsigned long long escaped = 0, top = 0;
+    unsigned int slowest = 0;
+    for (unsigned int t = 0; t < tile_count; ++t) {
+        const unsigned int *tile = stats + t * TILE_STATS_SIZE;
+        if (tile[STAT_MAX] > slowest)
+            slowest = tile[STAT_MAX];
+        for (unsigned int b = 0; b < STAT_BINS; ++b)
+            escaped += tile[STAT_HIST + b];
+        top += tile[STAT_HIST + STAT_BINS - 1];
     }
 
-    FILE *frag_file = fopen(frag_filepath, "r");
-    if (!frag_file) {
-        int error = errno;
-        fprintf(stderr, "unable to load fragment shader at '%s'.\nerror: %s", frag_filepath, strerror(error));
-        exit(EXIT_FAILURE);
-    }
-
-    fseek(vert_file, 0, SEEK_END);
-    unsigned int vert_size = ftell(vert_file);
-    fseek(vert_file, 0, SEEK_SET);
-
-    fseek(frag_file, 0, SEEK_END);
-    unsigned int frag_size = ftell(frag_file);
-    fseek(frag_file, 0, SEEK_SET);
-
-    char *vert_content = malloc(vert_size + 1);
-    fread(vert_content, vert_size, 1, vert_file);
-    vert_content[vert_size] = 0;
-
-    char *frag_content = malloc(frag_size + 1);
-    fread(frag_content, frag_size, 1, frag_file);
-    frag_content[frag_size] = 0;
-
-    unsigned int vert = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vert, 1, (const char**)&vert_content, NULL);
-    glCompileShader(vert);
-
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vert, GL_COMPILE_STATUS, &success);
-
-    if (!success) {
-        glGetShaderInfoLog(vert, 512, NULL, infoLog);
-        fprintf(stderr, "vertex shader failed to compile.\nerror: %s\n", infoLog);
-        exit(EXIT_FAILURE);
-    }
-
-    unsigned int frag = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag, 1, (const char**)&frag_content, NULL);
-    glCompileShader(frag);
-
-    glGetShaderiv(frag, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(frag, 512, NULL, infoLog);
-        fprintf(stderr, "fragment shader failed to compile.\nerror: %s\n", infoLog);
-        exit(EXIT_FAILURE);
-    }
-    
-    free(vert_content);
-    free(frag_content);
-
-    unsigned int prog = glCreateProgram();
-
-    glAttachShader(prog, vert);
-    glAttachShader(prog, frag);
+    // nothing escaped, nothing to go on
+    if (!escaped)
+        return max_iters;
 
-    glLinkProgram(prog);
+    if (top * 1000 > escaped)
+        return max_iters * 2;
 
-    glGetProgramiv(prog, GL_LINK_STATUS, &success);
-    if(!success) {
-        glGetProgramInfoLog(prog, 512, NULL, infoLog);
-        fprintf(stderr, "render shader program failed to link.\nerror: %s\n", infoLog);
-        exit(EXIT_FAILURE);
-    }
-
-    glDeleteShader(vert);
-    glDeleteShader(frag);
-
-    return prog;
+    unsigned int target = slowest + slowest / 4;
+    if (target < AUTO_ITERS_MIN)
+        target = AUTO_ITERS_MIN;
+    // only worth a recompute if it saves a fair amount of work
+    return target < max_iters * 4 / 5 ? target : max_iters;
 }
 
-unsigned int compile_compute_shader(const char* filepath) {
-    FILE *file = fopen(filepath, "r");
-    if (!file) {
-        int error = errno;
-        fprintf(stderr, "unable to load compute shader at '%s'.\nerror: %s", filepath, strerror(error));
-        exit(EXIT_FAILURE);
-    }
-
-    fseek(file, 0, SEEK_END);
-    unsigned int size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    char *content = malloc(size + 1);
-    fread(content, size, 1, file);
-    content[size] = 0;
-
-    unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
-    glShaderSource(shader, 1, (const char**)&content, NULL);
-    glCompileShader(shader);
-
-    int success;
-    char infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-
-    if (!success) {
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        fprintf(stderr, "compute shader failed to compile.\nerror: %s\n", infoLog);
-        exit(EXIT_FAILURE);
-    }
-
-    free(content);
-
-    unsigned int prog = glCreateProgram();
-
-    glAttachShader(prog, shader);
-
-    glLinkProgram(prog);
-    
-    glGetProgramiv(prog, GL_LINK_STATUS, &success);
-    if(!success) {
-        glGetProgramInfoLog(prog, 512, NULL, infoLog);
-        fprintf(stderr, "compute shader program failed to link.\nerror: %s\n", infoLog);
-        exit(EXIT_FAILURE);
-    }
-
-    glDeleteShader(shader);
-
-    return prog;
-}
-
-typedef struct {
-    float r;
-    float g;
-    float b;
-} color;
-
-typedef struct {
-    color color;
-    float s;
-    unsigned char pos;
-} interval;
-
-typedef struct {
-    double x;
-    double y;
-} dd;
-
-// double precision functions
-dd dd_set(double d) {
-    dd t = {d, 0.0};
-    return t;
-}
-
-dd dd_split64(double d)
-{
-    const double SPLITTER = (1 << 29) + 1;
-    double t = d * SPLITTER;
-    dd result;
-    result.x = t - (t - d);
-    result.y = d - result.x;
-
-    return result;
-}
-
-dd dd_quick_two_sum(double a, double b)
-{
-    dd temp;
-    temp.x = a + b;
-    temp.y = b - (temp.x - a);
-    return temp;
-}
-
-dd dd_two_prod(double a, double b) {
-    dd p;
-    p.x = a * b;
-    dd aS = dd_split64(a);
-    dd bS = dd_split64(b);
-    p.y = (aS.x * bS.x - p.x) + aS.x * bS.y + aS.y * bS.x + aS.y * bS.y;
-    return p;
-}
-
-dd dd_add(dd dsa, dd dsb)
-{
-    dd dsc;
-    double t1, t2, e;
-
-    t1 = dsa.x + dsb.x;
-    e = t1 - dsa.x;
-    t2 = ((dsb.x - e) + (dsa.x - (t1 - e))) + dsa.y + dsb.y;
-
-    dsc.x = t1 + t2;
-    dsc.y = t2 - (dsc.x - t1);
-    return dsc;
-}
-
-dd dd_sub(dd dsa, dd dsb) {
-    dd dsb_m = {-dsb.x, -dsb.y};
-    return dd_add(dsa, dsb_m);
+unsigned long long tile_work(const unsigned int *tile, unsigned int stat) {
+    return tile[stat] | (unsigned long long)tile[stat + 1] << 32;
 }
 
-dd dd_mul(dd a, dd b)
-{
-    dd p;
-
-    p = dd_two_prod(a.x, b.x);
-    p.y += a.x * b.y + a.y * b.x;
-    p = dd_quick_two_sum(p.x, p.y);
-    return p;
-}
-
-dd dd_div(dd b, dd a) {
-    double xn = 1.0 / a.x;
-    dd yn = {b.x * xn, 0.0};
-    dd a_yn = dd_mul(a, yn);
-    a_yn.x = -a_yn.x;
-    a_yn.y = -a_yn.y;
-
-    double diff = (dd_add(b, a_yn)).x;
-    dd prod = dd_two_prod(xn, diff);
-    return dd_add(yn, prod);
-}
-
-dd dd_abs(dd a) {
-    if (a.x < 0.0 || (a.x == 0.0 && a.y < 0.0)) {
-        a = (dd){-a.x, -a.y};
+// prints the iterations executed for the last computed view and the tiles that cost the most
+void dump_work(const unsigned int *stats, unsigned int tiles_x, unsigned int tiles_y, unsigned int tile_size, double time) {
+    unsigned int tile_count = tiles_x * tiles_y;
+    unsigned long long work = 0, aa_work = 0, limit = 0;
+    unsigned int top[TOP_TILES];
+    unsigned int top_count = 0;
+    for (unsigned int t = 0; t < tile_count; ++t) {
+        const unsigned int *tile = stats + t * TILE_STATS_SIZE;
+        work += tile_work(tile, STAT_WORK);
+        aa_work += tile_work(tile, STAT_AA_WORK);
+        limit += tile[STAT_LIMIT];
+
+        // insertion into the short list of most expensive tiles
+        unsigned int i = top_count < TOP_TILES ? top_count++ : TOP_TILES;
+        while (i > 0 && tile_work(tile, STAT_WORK) > tile_work(stats + top[i - 1] * TILE_STATS_SIZE, STAT_WORK)) {
+            if (i < TOP_TILES)
+                top[i] = top[i - 1];
+            --i;
+        }
+        if (i < TOP_TILES)
+            top[i] = t;
     }
-    return a;
-}
 
-char dd_gt(dd a, dd b) {
-     return (a.x > b.x || (a.x == b.x && a.y > b.y));
+    unsigned long long pixels = (unsigned long long)tile_count * tile_size * tile_size;
+    printf("WORK INFO:\n");
+    printf("\ttime: %f s\n", time);
+    printf("\titerations: %llu (%f per pixel)\n", work, (double)work / pixels);
+    printf("\textra aa subsamples: %llu (%.1f%%)\n", aa_work, work ? 100.0 * aa_work / work : 0.0);
+    printf("\tpixels at max iters: %llu (%.1f%%)\n", limit, 100.0 * limit / pixels);
+    printf("\tmost expensive tiles:\n");
+    for (unsigned int i = 0; i < top_count; ++i) {
+        const unsigned int *tile = stats + top[i] * TILE_STATS_SIZE;
+        printf("\t\t(%u, %u): %llu iterations, %u at max iters\n", (top[i] % tiles_x) * tile_size, (top[i] / tiles_x) * tile_size, tile_work(tile, STAT_WORK), tile[STAT_LIMIT]);
+    }
 }
 
-char dd_eq(dd a, dd b) {
-    return (a.x == b.x && a.y == b.y);
-}
+enum input_mode { MOVE, HUE, RECORD };
 
-dd dd_nth_pow(dd a, unsigned int n) {
-    if (!n)
-        return dd_set(1.0);
-    dd t = a;
-    while (--n)
-        t = dd_mul(t, a);
-    return t;
-}
+static fe mag = {0.5, 0};
+static dd x_offset = {0.0, 0.0}, y_offset = {0.0, 0.0};
 
-dd dd_nth_root(dd a, unsigned int n) {
-    dd x = {1.0/pow(a.x, 1.0/n), 0.0};
-    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) ); // x = x + (x * (1 - ax^n) ) / n
-    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) );
-    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) );
-    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) );
-    x = dd_add( x, dd_div( dd_mul( x, dd_sub( dd_set(1.0), dd_mul( a, dd_nth_pow(x, n) ) ) ), dd_set((double)n) ) );
-    return dd_abs(dd_div(dd_set(1.0), x));
+// moves the view by step view widths. the center is a dd, so deep enough a step is below its last bit
+static void pan(dd *offset, double step) {
+    dd moved = dd_add(*offset, dd_set(fe_to_double(fe_div(fe_set(step), mag))));
+    if (dd_eq(moved, *offset))
+        printf("the step is past what the dd center resolves. zoom out to move.\n");
+    *offset = moved;
 }
 
-enum input_mode { MOVE, HUE, RECORD };
-
-static dd mag = {0.5, 0.0};
-static dd x_offset = {0.0, 0.0}, y_offset = {0.0, 0.0};
 static char regen_set = 1;
 
 static int current_mode = MOVE;
@@ -297,14 +142,18 @@ static interval intervals[MAX_INTERVAL_COUNT] = {
 };
 
 
+static char julia = 0;
+static unsigned int power = 2;
+static dd julia_cx = {-0.8, 0.0}, julia_cy = {0.156, 0.0};
+
 static char recording = 0;
 static char finalize_rec = 0;
 
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     if (yoffset > 0.0f)
-        mag = dd_mul(mag, dd_set(1.1));
+        mag = fe_mul(mag, fe_set(1.1));
     else
-        mag = dd_mul(mag, dd_set(1.0/1.1));
+        mag = fe_mul(mag, fe_set(1.0/1.1));
     regen_set = 1;
 }
 
@@ -323,30 +172,6 @@ void *get_commands(void *arg) {
     return NULL;
 }
 
-color c_lerp(color a, color b, float t) {
-    color res = {(1 - t) * a.r + t * b.r, (1 - t) * a.g + t * b.g, (1 - t) * a.b + t * b.b};
-    return res;
-}
-
-void gen_hue(color start_color, unsigned int int_count, interval *intervals, unsigned int col_count, color *hue) {
-    for (unsigned int i = 0; i < col_count; ++i)
-        hue[i] = start_color;
-
-    if (!int_count)
-        return;
-
-    unsigned char last_pos = 0;
-    for (unsigned int i = 0; i < int_count; ++i) {
-        color s_color = i > 0 ? intervals[i - 1].color : start_color;
-        unsigned int range = (intervals[i].pos - last_pos) > 0 ? intervals[i].pos - last_pos : 0;
-        for (unsigned int j = 0; j <= range; ++j) {
-            float t = pow((float)j/range, intervals[i].s);
-            hue[j + last_pos] = c_lerp(s_color, intervals[i].color, t);
-        }
-        last_pos = intervals[i].pos + 1;
-    }
-}
-
 // TODO: do continous input (holding down keys)
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (action == GLFW_PRESS) {
@@ -368,20 +193,23 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         if (current_mode == MOVE) {
             switch (key) {
                 case GLFW_KEY_W:
-                    y_offset = dd_add(y_offset, dd_div(dd_set(0.1), mag));
+                    pan(&y_offset, 0.1);
                     break;
                 case GLFW_KEY_A:
-                    x_offset = dd_add(x_offset, dd_div(dd_set(-0.1), mag));
+                    pan(&x_offset, -0.1);
                     break;
                 case GLFW_KEY_S:
-                    y_offset = dd_add(y_offset, dd_div(dd_set(-0.1), mag));
+                    pan(&y_offset, -0.1);
                     break;
                 case GLFW_KEY_D:
-                    x_offset = dd_add(x_offset, dd_div(dd_set(0.1), mag));
+                    pan(&x_offset, 0.1);
                     break;
-                case GLFW_KEY_P:
-                    printf("mag: %f, offset: (%f, %f).\n", mag.x, x_offset.x, y_offset.x);
+                case GLFW_KEY_P: {
+                    char mag_str[64];
+                    fe_sprint(mag_str, mag);
+                    printf("mag: %s, offset: (%f, %f).\n", mag_str, x_offset.x, y_offset.x);
                     break;
+                }
             }
             regen_set = 1;
         }
@@ -457,7 +285,28 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     }
 }
 
-int main() {
+int main(int argc, char **argv) {
+    const char *batch_filename = NULL;
+    unsigned int batch_jobs = BATCH_JOBS;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-julia"))
+            julia = 1;
+        else if (!strcmp(argv[i], "-power") && i + 1 < argc && sscanf(argv[i + 1], "%u", &power) == 1 && power >= 2)
+            ++i;
+        else if (!strcmp(argv[i], "-batch") && i + 1 < argc)
+            batch_filename = argv[++i];
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc && sscanf(argv[i + 1], "%u", &batch_jobs) == 1 && batch_jobs > 0)
+            ++i;
+        else {
+            fprintf(stderr, "usage: %s [-julia] [-power n] [-batch jobfile [-j n]]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // unattended rendering, no window. -julia and -power apply to every job
+    if (batch_filename)
+        exit(run_batch(batch_filename, batch_jobs, julia, power) ? EXIT_FAILURE : EXIT_SUCCESS);
+
     if (!glfwInit()) {
         const char *description;
         int code = glfwGetError(&description);
@@ -521,28 +370,98 @@ int main() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    unsigned char *texture_data = malloc(w * h);
+    unsigned char *texture_data = calloc(w * h, 1);
     
-    unsigned int texture;
-    glGenTextures(1, &texture);
+    // textures[display] is shown while the compute shader writes the other one
+    unsigned int textures[2];
+    unsigned int display = 0;
+    glGenTextures(2, textures);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    for (unsigned int i = 0; i < 2; ++i) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, texture_data);
+    }
 
+    glBindTexture(GL_TEXTURE_2D, textures[display]);
+    glBindImageTexture(0, textures[!display], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+
+    // full escape counts of the last computed view, read back when recording an iteration field
+    unsigned int iter_texture;
+    glGenTextures(1, &iter_texture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, iter_texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, texture_data);
-
-    glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, w, h, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glBindImageTexture(2, iter_texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+
+    // iterations executed per pixel, sampled by the heatmap
+    unsigned int work_texture;
+    glGenTextures(1, &work_texture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, work_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, w, h, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glActiveTexture(GL_TEXTURE0);
+    glBindImageTexture(3, work_texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
 
-    unsigned int compute_prog = compile_compute_shader("genset.glsl");
+    const unsigned int work_group_size = 32;
+    const unsigned int tile_count = (w / work_group_size) * (h / work_group_size);
+    unsigned int *tile_stats = calloc(tile_count * TILE_STATS_SIZE, sizeof(unsigned int));
+
+    unsigned int stats_buffer;
+    glGenBuffers(1, &stats_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, stats_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, tile_count * TILE_STATS_SIZE * sizeof(unsigned int), NULL, GL_DYNAMIC_READ);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, stats_buffer);
+
+    // reference orbit for perturbation, recomputed when the center, julia c or limit it was made for changes
+    unsigned int orbit_buffer;
+    glGenBuffers(1, &orbit_buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, orbit_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(double), NULL, GL_STATIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, orbit_buffer);
+    double *orbit = NULL;
+    unsigned int orbit_len = 0, orbit_iters = 0;
+    dd orbit_x = {0.0, 0.0}, orbit_y = orbit_x, orbit_cx = orbit_x, orbit_cy = orbit_x;
+
+    char defines[MAX_DEFINES_SIZE];
+    gen_kernel_defines(julia, power, defines);
+    double shader_start = glfwGetTime();
+    unsigned int compute_prog = compile_compute_shader(genset_src, defines);
     
-    unsigned int render_prog = compile_render_shaders("vert.glsl", "frag.glsl");
+    unsigned int render_prog = compile_render_shaders(vert_src, frag_src);
+    printf("shaders ready in %f s.\n", glfwGetTime() - shader_start);
     glUseProgram(render_prog);
-
-    const unsigned int work_group_size = 32;
+    glUniform1i(glGetUniformLocation(render_prog, "work"), 2);
+
+    fe display_mag = mag, job_mag = mag;
+    dd display_x = x_offset, display_y = y_offset;
+    dd job_x = x_offset, job_y = y_offset;
+    // limits the computed image was dispatched with. auto iters changes max_iters as soon as a job finishes
+    unsigned int job_iters = 0, job_palette_iters = 0;
+    char computing = 0;
+    unsigned int next_row = 0;
+    unsigned int slice_groups = 1;
+    unsigned int timed_groups = 0;
+    // gpu time of the last slice. wall time between dispatch and poll always includes a swap, so it can't be used
+    unsigned int slice_query;
+    glGenQueries(1, &slice_query);
+    GLsync fence = 0;
+    char heatmap = 0;
+    double job_start = 0.0, job_time = 0.0;
+    char auto_iters = 1;
+    char auto_regen = 0;
+    char too_deep = 0;
+    unsigned int auto_passes = 0;
     unsigned int antialiasing = 0;
     unsigned int max_iters = 1300;
+    // set by set_iters, auto iters leaves it alone
+    unsigned int palette_iters = max_iters;
 
     char command[MAX_COMMAND_SIZE + 1];
     char load_commands = 0;
@@ -552,33 +471,172 @@ int main() {
     pthread_create(&thread_id, NULL, get_commands, (void*)command);
 
     recorder_context rc;
-    dd rec_mag = {0.5, 0.0};
+    fe rec_mag = {0.5, 0};
     double rec_vel = 0.0;
-    dd rec_step = {0.0, 0.0};
+    fe rec_step = {0.0, 0};
     unsigned int rec_fps = 30;
     unsigned int rec_bitrate = 100000;
     unsigned int rec_progress = 0;
     unsigned int rec_est = 0;
     char rec_filename[MAX_PATH_SIZE] = {0};
+    char rec_iters_filename[MAX_PATH_SIZE] = {0};
+    iterfield_context ic;
+    unsigned int *iter_data = malloc(w * h * sizeof(unsigned int));
     unsigned char *screen = malloc(w * h * 3);
 
+    buddha_context bc;
+    char buddha = 0;
+    double buddha_last_merge = 0.0;
+    unsigned int buddha_min_iters = 20;
+    unsigned int buddha_max_iters = 1000;
+    char buddha_importance = 0;
+    unsigned int worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+
     assert(!glGetError());
 
     while (!glfwWindowShouldClose(window)) {
         glClear(GL_COLOR_BUFFER_BIT);
 
+        if (regen_set && buddha) {
+            stop_buddha(&bc);
+            buddha_params params = { w, h, fe_to_double(mag), x_offset.x, y_offset.x, buddha_min_iters, buddha_max_iters, buddha_importance };
+            start_buddha(&bc, &params, worker_count);
+            buddha_last_merge = glfwGetTime();
+            display_mag = mag;
+            display_x = x_offset;
+            display_y = y_offset;
+            regen_set = 0;
+        }
+
+        if (buddha && glfwGetTime() - buddha_last_merge > BUDDHA_REFRESH_TIME) {
+            merge_buddha(&bc, texture_data);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RED, GL_UNSIGNED_BYTE, texture_data);
+            buddha_last_merge = glfwGetTime();
+        }
+
+        // a new view restarts the compute from the first row. the previous image stays on screen,
+        // reprojected to the new view, until every slice of the new one is done
         if (regen_set) {
             glUseProgram(compute_prog);
-            glUniform2d(glGetUniformLocation(compute_prog, "mag"), mag.x, mag.y);
+            glUniform1d(glGetUniformLocation(compute_prog, "mag_m"), mag.m);
+            glUniform1i(glGetUniformLocation(compute_prog, "mag_exp"), mag.e);
             glUniform2d(glGetUniformLocation(compute_prog, "offsetx"), x_offset.x, x_offset.y);
             glUniform2d(glGetUniformLocation(compute_prog, "offsety"), y_offset.x, y_offset.y);
+            glUniform2d(glGetUniformLocation(compute_prog, "julia_cx"), julia_cx.x, julia_cx.y);
+            glUniform2d(glGetUniformLocation(compute_prog, "julia_cy"), julia_cy.x, julia_cy.y);
             glUniform1ui(glGetUniformLocation(compute_prog, "antialiasing"), antialiasing);
             glUniform1ui(glGetUniformLocation(compute_prog, "max_iters"), max_iters);
-            glDispatchCompute(w / work_group_size, h / work_group_size, 1);
-            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            glUniform1ui(glGetUniformLocation(compute_prog, "palette_iters"), palette_iters);
+            char perturb = use_perturbation(power, mag, w);
+            if (perturb && (!orbit_len || orbit_iters != max_iters || !dd_eq(orbit_x, x_offset) || !dd_eq(orbit_y, y_offset) || !dd_eq(orbit_cx, julia_cx) || !dd_eq(orbit_cy, julia_cy))) {
+                orbit = realloc(orbit, (max_iters + 1) * 2 * sizeof(double));
+                orbit_len = gen_ref_orbit(julia, x_offset, y_offset, julia_cx, julia_cy, max_iters, orbit);
+                orbit_iters = max_iters;
+                orbit_x = x_offset;
+                orbit_y = y_offset;
+                orbit_cx = julia_cx;
+                orbit_cy = julia_cy;
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, orbit_buffer);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, orbit_len * 2 * sizeof(double), orbit, GL_STATIC_DRAW);
+            }
+            glUniform1ui(glGetUniformLocation(compute_prog, "perturb"), perturb);
+            glUniform1ui(glGetUniformLocation(compute_prog, "ref_len"), orbit_len);
+            // mag * w is the inverse pixel spacing, the offsets are around 1
+            char deep = !perturb && fe_gt(fe_mul(mag, fe_set(w)), fe_ldexp(fe_set(1.0), DD_RESOLVE_BITS));
+            if (deep && !too_deep) {
+                char mag_str[64];
+                fe_sprint(mag_str, mag);
+                printf("mag %s is past what dd coordinates resolve. the image will be blocky.\n", mag_str);
+            }
+            too_deep = deep;
+            job_mag = mag;
+            job_iters = max_iters;
+            job_palette_iters = palette_iters;
+            job_x = x_offset;
+            job_y = y_offset;
+            job_start = glfwGetTime();
+            if (!auto_regen)
+                auto_passes = 0;
+            auto_regen = 0;
+            next_row = 0;
+            computing = 1;
             regen_set = 0;
         }
 
+        if (computing && fence) {
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                glDeleteSync(fence);
+                fence = 0;
+                // keep each slice between one and two SLICE_TIME of gpu time so drawing never waits long behind the compute
+                if (timed_groups) {
+                    GLuint64 gpu_time;
+                    glGetQueryObjectui64v(slice_query, GL_QUERY_RESULT, &gpu_time);
+                    double elapsed = gpu_time * 1e-9;
+                    // a short last slice says nothing about whether a full one could be bigger
+                    if (elapsed < SLICE_TIME && timed_groups == slice_groups && slice_groups < h / work_group_size)
+                        slice_groups *= 2;
+                    else if (elapsed > 2 * SLICE_TIME && slice_groups > 1)
+                        slice_groups /= 2;
+                }
+            }
+        }
+
+        if (computing && !fence) {
+            if (next_row >= h) {
+                display = !display;
+                glBindTexture(GL_TEXTURE_2D, textures[display]);
+                glBindImageTexture(0, textures[!display], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+                display_mag = job_mag;
+                display_x = job_x;
+                display_y = job_y;
+                computing = 0;
+                job_time = glfwGetTime() - job_start;
+
+                glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, tile_count * TILE_STATS_SIZE * sizeof(unsigned int), tile_stats);
+                if (auto_iters) {
+                    unsigned int tuned = tune_iters(tile_stats, tile_count, job_iters);
+                    // while recording the next frame just starts from the tuned value. the palette follows palette_iters, so
+                    // this doesn't shift colors. it only grows, since a cut off frame isn't recomputed, and by at most
+                    // 1/AUTO_ITERS_REC_GROWTH a frame so frame times stay even
+                    if (recording) {
+                        unsigned int limit = job_iters + job_iters / AUTO_ITERS_REC_GROWTH + 1;
+                        if (tuned > job_iters)
+                            max_iters = tuned < limit ? tuned : limit;
+                    }
+                    // a lower limit classifies every pixel the same and the colors follow palette_iters, so recomputing
+                    // would give the same image. it just applies to the next view. only a raised limit is recomputed
+                    else if (tuned < job_iters)
+                        max_iters = tuned;
+                    else if (tuned > job_iters && auto_passes < AUTO_ITERS_PASSES) {
+                        printf("auto iters: %u -> %u\n", job_iters, tuned);
+                        max_iters = tuned;
+                        auto_passes++;
+                        auto_regen = 1;
+                        regen_set = 1;
+                    }
+                }
+            }
+            else {
+                // nobody looks at the screen while recording, so a frame is computed in one go
+                unsigned int groups = (h - next_row) / work_group_size;
+                if (!recording && slice_groups < groups)
+                    groups = slice_groups;
+                timed_groups = recording ? 0 : groups;
+                glUseProgram(compute_prog);
+                glUniform1ui(glGetUniformLocation(compute_prog, "row_offset"), next_row);
+                if (timed_groups)
+                    glBeginQuery(GL_TIME_ELAPSED, slice_query);
+                glDispatchCompute(w / work_group_size, groups, 1);
+                if (timed_groups)
+                    glEndQuery(GL_TIME_ELAPSED);
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+                fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glFlush();
+                next_row += groups * work_group_size;
+            }
+        }
+
         glUseProgram(render_prog);
 
         if (change_mode) {
@@ -591,15 +649,30 @@ int main() {
             change_hue = 0;
         }
 
+        glUniform1i(glGetUniformLocation(render_prog, "heatmap"), heatmap);
+        // the work image belongs to the last dispatched job, auto iters may have moved max_iters since
+        glUniform1f(glGetUniformLocation(render_prog, "heat_max"), (float)job_iters * (antialiasing < 2 ? 1 : antialiasing * antialiasing));
+
+        double view_scale = fe_to_double(fe_div(display_mag, mag));
+        glUniform2f(glGetUniformLocation(render_prog, "view_scale"), view_scale, view_scale);
+        glUniform2f(glGetUniformLocation(render_prog, "view_shift"), fe_to_double(fe_mul(fe_set(dd_sub(x_offset, display_x).x), display_mag)), fe_to_double(fe_mul(fe_set(dd_sub(y_offset, display_y).x), display_mag)) * w / h);
+
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-        if (recording) {
+        // only finished frames are recorded
+        if (recording && !computing) {
             if (rec_progress % 20 == 0)
                 printf("about %u%% done. %u/%u\n", (rec_progress*100)/rec_est, rec_progress, rec_est);
             glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, screen);
             encode_frame(&rc, screen);
-            if (dd_gt(mag, rec_mag) || dd_eq(mag, rec_mag) || finalize_rec) {
+            if (rec_iters_filename[0]) {
+                glGetTextureImage(iter_texture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, w * h * sizeof(unsigned int), iter_data);
+                write_iter_frame(&ic, iter_data, job_iters, job_palette_iters);
+            }
+            if (fe_gt(mag, rec_mag) || fe_eq(mag, rec_mag) || finalize_rec) {
                 finalize_recorder(&rc);
+                if (rec_iters_filename[0])
+                    finalize_iter_writer(&ic);
                 recording = 0;
                 rec_progress = 0;
                 finalize_rec = 0;
@@ -607,7 +680,7 @@ int main() {
                 printf("finished recording. current mode: MOVE\n");
                 continue;
             }
-            mag = dd_mul(mag, rec_step);
+            mag = fe_mul(mag, rec_step);
             regen_set = 1;
             rec_progress++;
         }
@@ -648,6 +721,24 @@ int main() {
                     printf("%c%u -> { {%f, %f, %f} , %f , %u}\n", i == selected_interval ? '*' : ' ', i, intervals[i].color.r, intervals[i].color.g, intervals[i].color.b, intervals[i].s, intervals[i].pos);
                 }
             }
+            else if (!strcmp(first_tok, "save_hue")) {
+                char hue_path[MAX_PATH_SIZE];
+                sscanf(strtok(NULL, " "), "%s", hue_path);
+                save_palette(hue_path, start_color, interval_count, intervals);
+                printf("saved palette.\n");
+            }
+            else if (!strcmp(first_tok, "load_hue")) {
+                char hue_path[MAX_PATH_SIZE];
+                sscanf(strtok(NULL, " "), "%s", hue_path);
+                if (load_palette(hue_path, &start_color, &interval_count, intervals)) {
+                    selected_interval = 0;
+                    gen_hue(start_color, interval_count, intervals, 256, hue);
+                    change_hue = 1;
+                    printf("loaded palette.\n");
+                }
+                else
+                    printf("unable to load palette at '%s'.\n", hue_path);
+            }
             else if (!strcmp(first_tok, "dump_int")) {
                 printf("static unsigned int interval_count = %u;\nstatic interval intervals[MAX_INTERVAL_COUNT] = {\n", interval_count);
                 for (unsigned int i = 0; i < interval_count; ++i) {
@@ -661,15 +752,41 @@ int main() {
                 regen_set = 1;
             }
             else if (!strcmp(first_tok, "set_mag")) {
-                sscanf(strtok(NULL, " "), "%16llx%16llx", (unsigned long long*)&mag.x, (unsigned long long*)&mag.y);
+                fe_scan_hex(strtok(NULL, " "), &mag);
                 printf("mag set.\n");
                 regen_set = 1;
             }
             else if (!strcmp(first_tok, "set_iters")) {
                 sscanf(strtok(NULL, " "), "%u", &max_iters);
-                printf("iters set.\n");
+                max_iters = max_iters ? max_iters : 1;
+                palette_iters = max_iters;
+                auto_iters = 0;
+                printf("iters set. auto iters disabled.\n");
+                regen_set = 1;
+            }
+            else if (!strcmp(first_tok, "set_auto_iters")) {
+                sscanf(strtok(NULL, " "), "%hhu", &auto_iters);
+                printf("auto iters %s.\n", auto_iters ? "enabled" : "disabled");
+                regen_set = 1;
+            }
+            else if (!strcmp(first_tok, "set_julia")) {
+                sscanf(strtok(NULL, " "), "{%16llx%16llx,%16llx%16llx}", (unsigned long long*)&julia_cx.x, (unsigned long long*)&julia_cx.y, (unsigned long long*)&julia_cy.x, (unsigned long long*)&julia_cy.y);
+                printf("julia c set.\n");
+                regen_set = 1;
+            }
+            else if (!strcmp(first_tok, "set_julia_approx")) {
+                julia_cx.y = julia_cy.y = 0.0;
+                sscanf(strtok(NULL, " "), "{%lf,%lf}", &julia_cx.x, &julia_cy.x);
+                printf("julia c set.\n");
                 regen_set = 1;
             }
+            else if (!strcmp(first_tok, "set_heatmap")) {
+                sscanf(strtok(NULL, " "), "%hhu", &heatmap);
+                printf("heatmap %s.\n", heatmap ? "enabled" : "disabled");
+            }
+            else if (!strcmp(first_tok, "dump_work")) {
+                dump_work(tile_stats, w / work_group_size, h / work_group_size, work_group_size, job_time);
+            }
             else if (!strcmp(first_tok, "set_aa")) {
                 sscanf(strtok(NULL, " "), "%u", &antialiasing);
                 printf("aa set.\n");
@@ -677,14 +794,22 @@ int main() {
             }
             else if (!strcmp(first_tok, "dump_ren")) {
                 printf("RENDER INFO:\n");
-                printf("\tmag: %.16llx%.16llx\n", *((unsigned long long*)&mag.x), *((unsigned long long*)&mag.y));
+                char mag_hex[64];
+                fe_print_hex(mag_hex, mag);
+                printf("\tmag: %s\n", mag_hex);
                 printf("\tpos: {%.16llx%.16llx,%.16llx%.16llx}\n", *((unsigned long long*)&x_offset.x), *((unsigned long long*)&x_offset.y), *((unsigned long long*)&y_offset.x), *((unsigned long long*)&y_offset.y));
-                printf("\titers: %u\n", max_iters);
+                printf("\titers: %u%s\n", max_iters, auto_iters ? " (auto)" : "");
+                printf("\tpalette iters: %u\n", palette_iters);
                 printf("\taa: %u\n", antialiasing);
-                printf("mag approx: %f pos approx: %f, %f\n", mag.x, x_offset.x, y_offset.x);
+                printf("\tfractal: %s, power %u\n", julia ? "julia" : "mandelbrot", power);
+                if (julia)
+                    printf("\tjulia c: {%.16llx%.16llx,%.16llx%.16llx}\n", *((unsigned long long*)&julia_cx.x), *((unsigned long long*)&julia_cx.y), *((unsigned long long*)&julia_cy.x), *((unsigned long long*)&julia_cy.y));
+                char mag_str[64];
+                fe_sprint(mag_str, mag);
+                printf("mag approx: %s pos approx: %f, %f\n", mag_str, x_offset.x, y_offset.x);
             }
             else if (!strcmp(first_tok, "rec_set_mag")) {
-                sscanf(strtok(NULL, " "), "%16llx%16llx", (unsigned long long*)&rec_mag.x, (unsigned long long*)&rec_mag.y);
+                fe_scan_hex(strtok(NULL, " "), &rec_mag);
                 printf("recording mag set.\n");
             }
             else if (!strcmp(first_tok, "rec_set_vel")) {
@@ -699,44 +824,113 @@ int main() {
                 sscanf(strtok(NULL, " "), "%s", rec_filename);
                 printf("recording filename set.\n");
             }
+            else if (!strcmp(first_tok, "rec_set_iters_filename")) {
+                sscanf(strtok(NULL, " "), "%s", rec_iters_filename);
+                if (!strcmp(rec_iters_filename, "-"))
+                    rec_iters_filename[0] = 0;
+                printf("recording iteration field filename %s.\n", rec_iters_filename[0] ? "set" : "cleared");
+            }
             else if (!strcmp(first_tok, "rec_set_bitrate")) {
                 sscanf(strtok(NULL, " "), "%u", &rec_bitrate);
                 printf("recording bitrate set.\n");
             }
             else if (!strcmp(first_tok, "dump_rec")) {
                 printf("RECORDING INFO:\n");
-                printf("\tend zoom: %.16llx%.16llx\n", *((unsigned long long*)&rec_mag.x), *((unsigned long long*)&rec_mag.y));
+                char mag_hex[64];
+                fe_print_hex(mag_hex, rec_mag);
+                printf("\tend zoom: %s\n", mag_hex);
                 printf("\tvel: %f\n", rec_vel);
                 printf("\tfps: %u\n", rec_fps);
                 printf("\tbitrate: %u\n", rec_bitrate);
                 printf("\tfilename: %s\n", rec_filename);
-                unsigned int t = ceil(rec_fps * log(rec_mag.x/mag.x)/log(rec_vel));
+                printf("\titeration field filename: %s\n", rec_iters_filename[0] ? rec_iters_filename : "-");
+                unsigned int t = ceil(rec_fps * fe_log(fe_div(rec_mag, mag))/log(rec_vel));
                 printf("estimated time (about %u frames): %f\n", t, t/(float)rec_fps);
-                printf("mag approx: %f\n", rec_mag.x);
+                char mag_str[64];
+                fe_sprint(mag_str, rec_mag);
+                printf("mag approx: %s\n", mag_str);
             }
             else if (!strcmp(first_tok, "rec_start")) {
                 AVRational framerate = { rec_fps, 1 };
                 printf("\n\nSTARTING TO RECORD\n---------------\ncodec info:\n");
                 initialize_recorder(&rc, AV_CODEC_ID_H265, rec_bitrate, framerate, w, h, AV_PIX_FMT_YUV420P, rec_filename);
-                rec_est = ceil(rec_fps * log(rec_mag.x/mag.x)/log(rec_vel));
-                rec_step = dd_nth_root(dd_set(rec_vel), rec_fps);
+                if (rec_iters_filename[0])
+                    initialize_iter_writer(&ic, rec_iters_filename, w, h, rec_fps, 0);
+                rec_est = ceil(rec_fps * fe_log(fe_div(rec_mag, mag))/log(rec_vel));
+                rec_step = fe_set(dd_nth_root(dd_set(rec_vel), rec_fps).x);
                 printf("filename: %s\n", rec_filename);
-                printf("\nstep: %f. estimated numer of frames: %u\n\nto stop the recording press space.\n\n", rec_step.x, rec_est);
+                printf("\nstep: %f. estimated numer of frames: %u\n\nto stop the recording press space.\n\n", fe_to_double(rec_step), rec_est);
                 current_mode = RECORD;
                 recording = 1;
             }
+            else if (!strcmp(first_tok, "buddha_set_iters")) {
+                sscanf(strtok(NULL, " "), "%u", &buddha_max_iters);
+                printf("buddhabrot iters set.\n");
+                regen_set = 1;
+            }
+            else if (!strcmp(first_tok, "buddha_set_min_iters")) {
+                sscanf(strtok(NULL, " "), "%u", &buddha_min_iters);
+                printf("buddhabrot min iters set.\n");
+                regen_set = 1;
+            }
+            else if (!strcmp(first_tok, "buddha_set_mh")) {
+                sscanf(strtok(NULL, " "), "%hhu", &buddha_importance);
+                printf("buddhabrot importance sampling %s.\n", buddha_importance ? "enabled" : "disabled");
+                regen_set = 1;
+            }
+            else if (!strcmp(first_tok, "buddha_start")) {
+                if (!buddha) {
+                    buddha_params params = { w, h, fe_to_double(mag), x_offset.x, y_offset.x, buddha_min_iters, buddha_max_iters, buddha_importance };
+                    start_buddha(&bc, &params, worker_count);
+                    buddha_last_merge = glfwGetTime();
+                    display_mag = mag;
+                    display_x = x_offset;
+                    display_y = y_offset;
+                    computing = 0;
+                    buddha = 1;
+                }
+                printf("started buddhabrot with %u threads.\n", worker_count);
+            }
+            else if (!strcmp(first_tok, "buddha_stop")) {
+                if (buddha) {
+                    unsigned long long samples = merge_buddha(&bc, texture_data);
+                    stop_buddha(&bc);
+                    buddha = 0;
+                    printf("stopped buddhabrot after %llu samples.\n", samples);
+                }
+                regen_set = 1;
+            }
+            else if (!strcmp(first_tok, "dump_buddha")) {
+                printf("BUDDHABROT INFO:\n");
+                printf("\trunning: %u\n", buddha);
+                printf("\titers: %u\n", buddha_max_iters);
+                printf("\tmin iters: %u\n", buddha_min_iters);
+                printf("\tmh: %u\n", buddha_importance);
+                printf("\tthreads: %u\n", worker_count);
+                if (buddha)
+                    printf("\tsamples: %llu\n", merge_buddha(&bc, texture_data));
+            }
             else if (!strcmp(first_tok, "save")) {
                 char settings_path[MAX_PATH_SIZE];
                 sscanf(strtok(NULL, " "), "%s", settings_path);
                 FILE *s_file = fopen(settings_path, "w");
                 fprintf(s_file, "set_pos {%.16llx%.16llx,%.16llx%.16llx}\n", *((unsigned long long*)&x_offset.x), *((unsigned long long*)&x_offset.y), *((unsigned long long*)&y_offset.x), *((unsigned long long*)&y_offset.y));
-                fprintf(s_file, "set_mag %.16llx%.16llx\n", *((unsigned long long*)&mag.x), *((unsigned long long*)&mag.y));
-                fprintf(s_file, "set_iters %u\n", max_iters);
-                fprintf(s_file, "rec_set_mag %.16llx%.16llx\n", *((unsigned long long*)&rec_mag.x), *((unsigned long long*)&rec_mag.y));
+                char mag_hex[64];
+                fe_print_hex(mag_hex, mag);
+                fprintf(s_file, "set_mag %s\n", mag_hex);
+                fprintf(s_file, "set_iters %u\n", palette_iters);
+                if (auto_iters)
+                    fprintf(s_file, "set_auto_iters 1\n");
+                if (julia)
+                    fprintf(s_file, "set_julia {%.16llx%.16llx,%.16llx%.16llx}\n", *((unsigned long long*)&julia_cx.x), *((unsigned long long*)&julia_cx.y), *((unsigned long long*)&julia_cy.x), *((unsigned long long*)&julia_cy.y));
+                fe_print_hex(mag_hex, rec_mag);
+                fprintf(s_file, "rec_set_mag %s\n", mag_hex);
                 fprintf(s_file, "rec_set_vel %f\n", rec_vel);
                 fprintf(s_file, "rec_set_fps %u\n", rec_fps);
                 fprintf(s_file, "rec_set_bitrate %u\n", rec_bitrate);
                 fprintf(s_file, "rec_set_filename %s\n", rec_filename);
+                if (rec_iters_filename[0])
+                    fprintf(s_file, "rec_set_iters_filename %s\n", rec_iters_filename);
                 fclose(s_file);
                 printf("saved settings.\n");
             }
@@ -767,7 +961,12 @@ int main() {
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+    if (buddha)
+        stop_buddha(&bc);
     free(texture_data);
+    free(tile_stats);
+    free(iter_data);
+    free(orbit);
     free(screen);
     pthread_cancel(thread_id);
     assert(!glGetError());
@@ -0,0 +1,80 @@
+#include "palette.h"
+
+#include <stdio.h>
+#include <math.h>
+
+color c_lerp(color a, color b, float t) {
+    color res = {(1 - t) * a.r + t * b.r, (1 - t) * a.g + t * b.g, (1 - t) * a.b + t * b.b};
+    return res;
+}
+
+void gen_hue(color start_color, unsigned int int_count, interval *intervals, unsigned int col_count, color *hue) {
+    for (unsigned int i = 0; i < col_count; ++i)
+        hue[i] = start_color;
+
+    if (!int_count)
+        return;
+
+    unsigned char last_pos = 0;
+    for (unsigned int i = 0; i < int_count; ++i) {
+        color s_color = i > 0 ? intervals[i - 1].color : start_color;
+        unsigned int range = (intervals[i].pos - last_pos) > 0 ? intervals[i].pos - last_pos : 0;
+        for (unsigned int j = 0; j <= range; ++j) {
+            float t = pow((float)j/range, intervals[i].s);
+            hue[j + last_pos] = c_lerp(s_color, intervals[i].color, t);
+        }
+        last_pos = intervals[i].pos + 1;
+    }
+}
+
+void gen_hue_rgb(color start_color, unsigned int int_count, interval *intervals, unsigned char hue_rgb[256][3]) {
+    color hue[256];
+    gen_hue(start_color, int_count, intervals, 256, hue);
+    for (unsigned int i = 0; i < 256; ++i) {
+        hue_rgb[i][0] = hue[i].r * 255.0f + 0.5f;
+        hue_rgb[i][1] = hue[i].g * 255.0f + 0.5f;
+        hue_rgb[i][2] = hue[i].b * 255.0f + 0.5f;
+    }
+}
+
+void color_iters(const unsigned int *iters, unsigned int size, unsigned int max_iters, unsigned int palette_iters, const unsigned char hue_rgb[256][3], unsigned char *image) {
+    // matches the palette index in genset.glsl
+    for (unsigned int i = 0; i < size; ++i) {
+        unsigned int index = 255;
+        if (iters[i] < max_iters)
+            index = (unsigned int)((double)(iters[i] % palette_iters) * 255.0 / palette_iters);
+        image[3 * i + 0] = hue_rgb[index][0];
+        image[3 * i + 1] = hue_rgb[index][1];
+        image[3 * i + 2] = hue_rgb[index][2];
+    }
+}
+
+void save_palette(const char *filename, color start_color, unsigned int int_count, const interval *intervals) {
+    FILE *file = fopen(filename, "w");
+    if (!file)
+        return;
+    fprintf(file, "start {%f,%f,%f}\n", start_color.r, start_color.g, start_color.b);
+    for (unsigned int i = 0; i < int_count; ++i)
+        fprintf(file, "int {%f,%f,%f} %f %u\n", intervals[i].color.r, intervals[i].color.g, intervals[i].color.b, intervals[i].s, intervals[i].pos);
+    fclose(file);
+}
+
+char load_palette(const char *filename, color *start_color, unsigned int *int_count, interval *intervals) {
+    FILE *file = fopen(filename, "r");
+    if (!file)
+        return 0;
+
+    if (fscanf(file, " start {%f,%f,%f}", &start_color->r, &start_color->g, &start_color->b) != 3) {
+        fclose(file);
+        return 0;
+    }
+
+    unsigned int count = 0;
+    interval t;
+    while (count < MAX_INTERVAL_COUNT && fscanf(file, " int {%f,%f,%f} %f %hhu", &t.color.r, &t.color.g, &t.color.b, &t.s, &t.pos) == 5)
+        intervals[count++] = t;
+    *int_count = count;
+
+    fclose(file);
+    return 1;
+}
@@ -0,0 +1,33 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#define MAX_INTERVAL_COUNT 100
+
+typedef struct {
+    float r;
+    float g;
+    float b;
+} color;
+
+typedef struct {
+    color color;
+    float s;
+    unsigned char pos;
+} interval;
+
+color c_lerp(color a, color b, float t);
+
+void gen_hue(color start_color, unsigned int int_count, interval *intervals, unsigned int col_count, color *hue);
+
+// 256 entry palette quantized to 8 bits per channel, like the render shader sees it
+void gen_hue_rgb(color start_color, unsigned int int_count, interval *intervals, unsigned char hue_rgb[256][3]);
+
+// colors size escape counts into rgb triples the same way genset.glsl and frag.glsl do
+void color_iters(const unsigned int *iters, unsigned int size, unsigned int max_iters, unsigned int palette_iters, const unsigned char hue_rgb[256][3], unsigned char *image);
+
+// palette files hold one "start {r,g,b}" line followed by an "int {r,g,b} s pos" line per interval.
+// load_palette returns 0 if the file can't be read
+void save_palette(const char *filename, color start_color, unsigned int int_count, const interval *intervals);
+char load_palette(const char *filename, color *start_color, unsigned int *int_count, interval *intervals);
+
+#endif /* PALETTE_H */
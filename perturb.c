@@ -0,0 +1,26 @@
+#include "perturb.h"
+
+char use_perturbation(unsigned int power, fe mag, unsigned int w) {
+    return power == 2 && fe_gt(fe_mul(mag, fe_set(w)), fe_ldexp(fe_set(1.0), PERTURB_BITS));
+}
+
+unsigned int gen_ref_orbit(char julia, dd x_offset, dd y_offset, dd julia_cx, dd julia_cy, unsigned int max_iters, double *orbit) {
+    dd zx = julia ? x_offset : dd_set(0.0);
+    dd zy = julia ? y_offset : dd_set(0.0);
+    dd cx = julia ? julia_cx : x_offset;
+    dd cy = julia ? julia_cy : y_offset;
+
+    unsigned int n;
+    for (n = 0; n <= max_iters; ++n) {
+        orbit[2 * n] = zx.x;
+        orbit[2 * n + 1] = zy.x;
+        // pixels rebase on the last point and step off the first, so keep two even if the center escapes at once
+        if (n > 0 && zx.x * zx.x + zy.x * zy.x >= 4.0)
+            return n + 1;
+
+        dd t = dd_add(dd_sub(dd_mul(zx, zx), dd_mul(zy, zy)), cx);
+        zy = dd_add(dd_mul(dd_add(zx, zx), zy), cy);
+        zx = t;
+    }
+    return n;
+}
@@ -0,0 +1,18 @@
+#ifndef PERTURB_H
+#define PERTURB_H
+
+#include "dd.h"
+#include "floatexp.h"
+
+// past this many bits of inverse pixel spacing (mag * width) power 2 views are computed as floatexp deltas around
+// a reference orbit of the view center (see genset.glsl). dd coordinates still leave 24 bits per pixel there
+#define PERTURB_BITS 80
+
+char use_perturbation(unsigned int power, fe mag, unsigned int w);
+
+// iterates the view center in dd, from z = center with c = julia c for julia sets and from z = 0 with c = center
+// otherwise, and stores the orbit rounded to double as x, y pairs. stops after the first escaped point, which is
+// kept, and after max_iters + 1 points. orbit needs room for that many. returns the number of points, at least 2
+unsigned int gen_ref_orbit(char julia, dd x_offset, dd y_offset, dd julia_cx, dd julia_cy, unsigned int max_iters, double *orbit);
+
+#endif /* PERTURB_H */
@@ -0,0 +1,36 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "record.h"
+#include "palette.h"
+#include "fieldvideo.h"
+
+// re-colors an iteration field recorded with rec_set_iters_filename and encodes it like a normal recording.
+// no escape time computation happens here, so it runs at encode speed
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s <iteration field> <palette> <output> [bitrate]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned int bitrate = 100000;
+    if (argc > 4)
+        sscanf(argv[4], "%u", &bitrate);
+
+    color start_color;
+    unsigned int interval_count;
+    interval intervals[MAX_INTERVAL_COUNT];
+    if (!load_palette(argv[2], &start_color, &interval_count, intervals)) {
+        fprintf(stderr, "unable to load palette at '%s'.\n", argv[2]);
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned char hue_rgb[256][3];
+    gen_hue_rgb(start_color, interval_count, intervals, hue_rgb);
+
+    if (!encode_iter_field(argv[1], hue_rgb, bitrate, argv[3])) {
+        fprintf(stderr, "unable to re-color iteration field at '%s'.\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+    printf("finished re-coloring.\n");
+}
@@ -0,0 +1,218 @@
+#include "shader.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <GL/glew.h>
+
+#include "util.h"
+
+// binaries are only valid for the driver that produced them, so the driver strings are part of the key
+static unsigned long long program_key(unsigned int count, const char **sources) {
+    unsigned long long h = FNV_OFFSET;
+    h = hash_str(h, (const char*)glGetString(GL_VENDOR));
+    h = hash_str(h, (const char*)glGetString(GL_RENDERER));
+    h = hash_str(h, (const char*)glGetString(GL_VERSION));
+    for (unsigned int i = 0; i < count; ++i)
+        h = hash_str(h, sources[i]);
+    return h;
+}
+
+static char cache_path(unsigned long long key, char *path) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char dir[PATH_MAX];
+    if (xdg && xdg[0])
+        snprintf(dir, PATH_MAX, "%s/mandelbrot-explorer", xdg);
+    else if (home)
+        snprintf(dir, PATH_MAX, "%s/.cache/mandelbrot-explorer", home);
+    else
+        return 0;
+
+    // the parent might not exist yet either
+    char *slash = strrchr(dir, '/');
+    *slash = 0;
+    mkdir(dir, 0755);
+    *slash = '/';
+    mkdir(dir, 0755);
+
+    snprintf(path, PATH_MAX, "%s/%016llx.bin", dir, key);
+    return 1;
+}
+
+// returns 0 if there is no usable cached binary
+static unsigned int load_program_binary(unsigned long long key) {
+    char path[PATH_MAX];
+    if (!cache_path(key, path))
+        return 0;
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return 0;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file) - (long)sizeof(GLenum);
+    fseek(file, 0, SEEK_SET);
+
+    GLenum format;
+    void *binary = size > 0 ? malloc(size) : NULL;
+    char read = binary && fread(&format, sizeof(format), 1, file) == 1 && fread(binary, size, 1, file) == 1;
+    fclose(file);
+
+    unsigned int prog = 0;
+    if (read) {
+        prog = glCreateProgram();
+        glProgramBinary(prog, format, binary, size);
+        int success;
+        glGetProgramiv(prog, GL_LINK_STATUS, &success);
+        // drivers reject binaries from other driver builds, fall back to compiling
+        if (!success) {
+            glDeleteProgram(prog);
+            prog = 0;
+        }
+    }
+    free(binary);
+    return prog;
+}
+
+static void save_program_binary(unsigned int prog, unsigned long long key) {
+    char path[PATH_MAX];
+    if (!cache_path(key, path))
+        return;
+
+    int size;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0)
+        return;
+
+    void *binary = malloc(size);
+    GLenum format;
+    glGetProgramBinary(prog, size, NULL, &format, binary);
+
+    // several processes (e.g. batch jobs) can miss the cache at once. each writes its own file and renames it
+    // into place, so a reader only ever sees a complete binary
+    char tmp_path[PATH_MAX + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+    FILE *file = fopen(tmp_path, "wb");
+    if (file) {
+        char ok = fwrite(&format, sizeof(format), 1, file) == 1 && fwrite(binary, size, 1, file) == 1;
+        ok = !fclose(file) && ok;
+        if (!ok || rename(tmp_path, path))
+            remove(tmp_path);
+    }
+    free(binary);
+}
+
+static unsigned int compile_shader(GLenum type, unsigned int count, const char **sources, const int *lengths, const char *name) {
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, count, sources, lengths);
+    glCompileShader(shader);
+
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+    if (!success) {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        fprintf(stderr, "%s shader failed to compile.\nerror: %s\n", name, infoLog);
+        exit(EXIT_FAILURE);
+    }
+
+    return shader;
+}
+
+static void link_program(unsigned int prog, const char *name) {
+    glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(prog);
+
+    int success;
+    char infoLog[512];
+    glGetProgramiv(prog, GL_LINK_STATUS, &success);
+    if(!success) {
+        glGetProgramInfoLog(prog, 512, NULL, infoLog);
+        fprintf(stderr, "%s shader program failed to link.\nerror: %s\n", name, infoLog);
+        exit(EXIT_FAILURE);
+    }
+}
+
+unsigned int compile_render_shaders(const char *vert_source, const char *frag_source) {
+    const char *sources[] = { vert_source, frag_source };
+    unsigned long long key = program_key(2, sources);
+    unsigned int prog = load_program_binary(key);
+    if (prog)
+        return prog;
+
+    unsigned int vert = compile_shader(GL_VERTEX_SHADER, 1, &vert_source, NULL, "vertex");
+    unsigned int frag = compile_shader(GL_FRAGMENT_SHADER, 1, &frag_source, NULL, "fragment");
+
+    prog = glCreateProgram();
+
+    glAttachShader(prog, vert);
+    glAttachShader(prog, frag);
+
+    link_program(prog, "render");
+
+    glDeleteShader(vert);
+    glDeleteShader(frag);
+
+    save_program_binary(prog, key);
+    return prog;
+}
+
+unsigned int compile_compute_shader(const char *source, const char *defines) {
+    const char *key_sources[] = { source, defines };
+    unsigned long long key = program_key(2, key_sources);
+    unsigned int prog = load_program_binary(key);
+    if (prog)
+        return prog;
+
+    // defines have to go after the #version line
+    const char *body = strchr(source, '\n');
+    body = body ? body + 1 : source + strlen(source);
+    const char *sources[] = { source, defines, body };
+    int lengths[] = { body - source, -1, -1 };
+
+    unsigned int shader = compile_shader(GL_COMPUTE_SHADER, 3, sources, lengths, "compute");
+
+    prog = glCreateProgram();
+
+    glAttachShader(prog, shader);
+
+    link_program(prog, "compute");
+
+    glDeleteShader(shader);
+
+    save_program_binary(prog, key);
+    return prog;
+}
+
+// generates the defines specializing genset.glsl for a fractal. z^power is emitted as a straight-line
+// square-and-multiply chain so the kernel has no power loop and no runtime branching on the mode
+void gen_kernel_defines(char julia, unsigned int power, char *defines) {
+    char *d = defines;
+    if (julia)
+        d += sprintf(d, "#define JULIA\n");
+    d += sprintf(d, "#define POWER %u\n", power);
+    if (power <= 2)
+        return;
+
+    // the first step is always a square, and its zx^2 and zy^2 are the ones the loop already has for the bailout test
+    d += sprintf(d, "#define Z_POW(zx, zy, z_sqx, z_sqy) { dvec2 bx = zx, by = zy, t; ");
+    unsigned int bit = 31;
+    while (!(power >> bit))
+        --bit;
+    char first = 1;
+    while (bit--) {
+        if (first)
+            d += sprintf(d, "t = ds_add(z_sqx, -z_sqy); zy = ds_mul(ds_add(zx, zx), zy); zx = t; ");
+        else
+            d += sprintf(d, "t = ds_add(ds_mul(zx, zx), -ds_mul(zy, zy)); zy = ds_mul(ds_add(zx, zx), zy); zx = t; ");
+        first = 0;
+        if ((power >> bit) & 1)
+            d += sprintf(d, "t = ds_add(ds_mul(zx, bx), -ds_mul(zy, by)); zy = ds_add(ds_mul(zx, by), ds_mul(zy, bx)); zx = t; ");
+    }
+    d += sprintf(d, "}\n");
+}
@@ -0,0 +1,28 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#define MAX_DEFINES_SIZE 16384
+
+// tile stats layout, see genset.glsl
+#define STAT_LIMIT 0
+#define STAT_MAX 1
+#define STAT_WORK 2
+#define STAT_AA_WORK 4
+#define STAT_HIST 6
+#define STAT_BINS 16
+#define TILE_STATS_SIZE (STAT_HIST + STAT_BINS)
+
+// shader sources embedded at build time (see shaders.c rule in the makefile)
+extern const char genset_src[];
+extern const char vert_src[];
+extern const char frag_src[];
+
+// both look the linked program up in the program binary cache first and store it there after compiling.
+// defines are inserted after the #version line of the compute shader
+unsigned int compile_render_shaders(const char *vert_source, const char *frag_source);
+unsigned int compile_compute_shader(const char *source, const char *defines);
+
+// fills defines (MAX_DEFINES_SIZE) with the specialization of genset.glsl for a fractal
+void gen_kernel_defines(char julia, unsigned int power, char *defines);
+
+#endif /* SHADER_H */
@@ -0,0 +1,23 @@
+#include "util.h"
+
+#include <string.h>
+#include <time.h>
+
+unsigned long long hash_bytes(unsigned long long h, const void *data, unsigned long size) {
+    const unsigned char *p = data;
+    for (unsigned long i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+unsigned long long hash_str(unsigned long long h, const char *s) {
+    return hash_bytes(h, s, strlen(s));
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
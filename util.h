@@ -0,0 +1,14 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+#define MAX_PATH_SIZE 1024
+
+// fnv-1a. start from FNV_OFFSET and feed the parts of a key in order
+#define FNV_OFFSET 0xcbf29ce484222325ull
+unsigned long long hash_bytes(unsigned long long h, const void *data, unsigned long size);
+unsigned long long hash_str(unsigned long long h, const char *s);
+
+// monotonic time in seconds, for timing without a glfw context
+double now();
+
+#endif /* UTIL_H */